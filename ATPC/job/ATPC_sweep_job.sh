@@ -0,0 +1,43 @@
+#!/bin/bash
+#SBATCH -J Sweep # A single job name for the array
+#SBATCH --nodes=1
+#SBATCH --cpus-per-task=32 # Worker processes of the sweep
+#SBATCH --mem 32000 # Memory request (32Gb, all meshes are kept in memory)
+#SBATCH -t 0-24:00 # Maximum execution time (D-HH:MM)
+#SBATCH -o Sweep_%A_%a.out # Standard output
+#SBATCH -e Sweep_%A_%a.err # Standard error
+
+start=`date +%s`
+
+# Set the configurable variables
+JOBNAME="GarfieldATPC"
+VOLTAGES="2500,3000,3500,4000,5000,6000,7000,8000"
+HEXES="2,4,6,8,10,12,14,16,18,20"
+N_THREADS=${SLURM_CPUS_PER_TASK:-1}
+
+MAPDIR="/home/argon/Projects/Krishan/garfieldpp/ATPC/build"
+IONMOBILITY="/home/argon/Projects/Krishan/garfieldpp/Data/IonMobility_Xe+_Xe.txt"
+
+# Create the directory
+cd /media/argon/HDD_8tb/
+mkdir -p $JOBNAME/sweep/jobid_"${SLURM_ARRAY_TASK_ID}"
+cd $JOBNAME/sweep/jobid_"${SLURM_ARRAY_TASK_ID}"
+
+# Setup nexus and run
+echo "Setting Up Garfield" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+source /home/argon/Projects/Krishan/garfieldpp/setup_garfield.sh
+
+# NEXUS
+echo "Running Garfield" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+/home/argon/Projects/Krishan/GarfieldCode/ATPC/build/ATPC sweep ${HEXES} ${VOLTAGES} threads=${N_THREADS} mapdir=${MAPDIR} ionmobility=${IONMOBILITY} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+
+echo; echo; echo;
+
+echo "FINISHED....EXITING" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+
+end=`date +%s`
+let deltatime=end-start
+let hours=deltatime/3600
+let minutes=(deltatime/60)%60
+let seconds=deltatime%60
+printf "Time spent: %d:%02d:%02d\n" $hours $minutes $seconds | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
\ No newline at end of file
@@ -1,5 +1,8 @@
 #!/bin/bash
 
+# Submits one job per (radius, voltage) point. To run the whole grid in a
+# single job that loads each mesh once, use: sbatch --array=1 ATPC_sweep_job.sh
+
 # Define arrays
 # voltages=(2500 3000 3500 4000 5000 6000 7000 8000)
 voltages=(2500)
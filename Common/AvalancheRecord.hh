@@ -0,0 +1,92 @@
+// Per-avalanche output of the electroluminescence drivers (Mesh, CRAB): the
+// summary that goes into the metadata table and the excitations that go into
+// the EventInfo table.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "WorkerPool.hh"
+
+// Excitations (VUV photons) recorded by the inelastic collision handle during
+// one avalanche, stored column by column
+struct ExcitationBuffer {
+    std::vector<float> x, y, z, t;
+
+    void Add(double xe, double ye, double ze, double te) {
+        x.push_back(xe);
+        y.push_back(ye);
+        z.push_back(ze);
+        t.push_back(te);
+    }
+
+    size_t size() const { return x.size(); }
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        t.clear();
+    }
+
+    void swap(ExcitationBuffer& other) {
+        x.swap(other.x);
+        y.swap(other.y);
+        z.swap(other.z);
+        t.swap(other.t);
+    }
+};
+
+// One line of the metadata file
+struct AvalancheInfo {
+    int event = 0;
+    int ne = 0, ni = 0;
+    unsigned int nEl = 0, nIon = 0, nAtt = 0, nInel = 0, nExc = 0;
+    unsigned int nTopPlane = 0, nBottomPlane = 0;
+    double x0 = 0., y0 = 0., z0 = 0.;
+    double e1 = 0., e2 = 0.;
+};
+
+struct AvalancheRecord {
+    AvalancheInfo info;
+    ExcitationBuffer excitations;
+
+    void Pack(std::string& payload) const {
+        WorkerPool::Pack(payload, info);
+        WorkerPool::Pack(payload, excitations.x);
+        WorkerPool::Pack(payload, excitations.y);
+        WorkerPool::Pack(payload, excitations.z);
+        WorkerPool::Pack(payload, excitations.t);
+    }
+
+    // Returns the position after the record, where the caller may have packed
+    // more (e.g. the excitation profile of output=summary)
+    size_t Unpack(const std::string& payload) {
+        size_t pos = 0;
+        WorkerPool::Unpack(payload, pos, info);
+        WorkerPool::Unpack(payload, pos, excitations.x);
+        WorkerPool::Unpack(payload, pos, excitations.y);
+        WorkerPool::Unpack(payload, pos, excitations.z);
+        WorkerPool::Unpack(payload, pos, excitations.t);
+        return pos;
+    }
+
+    // event,electrons,ions,elastic,ionisations,attachment,inelastic,excitation,top,bottom,start x,start y,start z, start E, end E
+    std::string MetadataLine() const {
+        return std::to_string(info.event)        + "," +
+               std::to_string(info.ne)           + "," +
+               std::to_string(info.ni)           + "," +
+               std::to_string(info.nEl)          + "," +
+               std::to_string(info.nIon)         + "," +
+               std::to_string(info.nAtt)         + "," +
+               std::to_string(info.nInel)        + "," +
+               std::to_string(info.nExc)         + "," +
+               std::to_string(info.nTopPlane)    + "," +
+               std::to_string(info.nBottomPlane) + "," +
+               std::to_string(info.x0)           + "," +
+               std::to_string(info.y0)           + "," +
+               std::to_string(info.z0)           + "," +
+               std::to_string(info.e1)           + "," +
+               std::to_string(info.e2);
+    }
+};
@@ -0,0 +1,468 @@
+// ComponentComsol with a binary cache of the parsed field map.
+//
+// Parsing the text .mphtxt mesh and .txt field files takes a large share of
+// a short job, and the same files are parsed again by every array task. The
+// first job converts the (mesh, material properties, field) triple into a
+// binary image with the nodes, elements, materials and potentials stored in
+// contiguous arrays. Later jobs mmap that image and copy the arrays into the
+// component instead, so startup takes a few large copies rather than a parse;
+// each job still holds its own copy of the map. The image records the size and
+// modification time of the three source files and the length unit, so checking
+// it does not read the text files; if any of them changed the image is ignored
+// and rebuilt from the text files.
+//
+// The same mesh at another voltage only needs its potentials: ReadPotentials
+// reads them from the field file alone onto the loaded mesh, and
+// MakePotentialCache stores them in an image for LoadPotentials.
+//
+// The image can also be made up front with the MakeFieldCache program.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Garfield/ComponentComsol.hh"
+
+class ComponentComsolCached : public Garfield::ComponentComsol {
+  public:
+    ComponentComsolCached() = default;
+
+    using Garfield::ComponentComsol::Initialise;
+
+    // Load the field map from the cache file if it matches the source files,
+    // otherwise parse the text files and (re)write the cache.
+    bool Initialise(const std::string& mesh, const std::string& mplist,
+                    const std::string& field, const std::string& unit,
+                    const std::string& cache) {
+        const Checksums sums = {FileStamp(mesh), FileStamp(mplist), FileStamp(field), HashString(unit)};
+        if (LoadCache(cache, sums)) return true;
+
+        std::cout << "ComponentComsolCached::Initialise: No valid cache in " << cache
+                  << ", reading the text files." << std::endl;
+        if (!Garfield::ComponentComsol::Initialise(mesh, mplist, field, unit)) return false;
+        WriteCache(cache, sums);
+        return true;
+    }
+
+    // Replace the potentials by the ones of another cache built on the same
+    // mesh (e.g. the same geometry at a different voltage). Much cheaper than
+    // loading the whole map again.
+    bool LoadPotentials(const std::string& cache) {
+        MappedFile f;
+        if (!f.Open(cache)) return false;
+        const Header* h = f.GetHeader();
+        if (!h || h->nNodes != m_nodes.size() || h->nElements != m_elements.size() ||
+            h->meshHash != m_sums.mesh || h->mplistHash != m_sums.mplist || h->unitHash != m_sums.unit) {
+            std::cerr << "ComponentComsolCached::LoadPotentials: " << cache
+                      << " does not belong to the loaded mesh and materials." << std::endl;
+            return false;
+        }
+        const double* pot = reinterpret_cast<const double*>(f.data + h->offPot);
+        m_pot.assign(pot, pot + h->nNodes);
+        UpdatePotentialRange();
+        m_sums.field = h->fieldHash;
+        return true;
+    }
+
+    // Replace the potentials by the ones of another field file on the same mesh,
+    // reading only that file. Each line of the field file is matched to the
+    // nearest node of the loaded mesh.
+    bool ReadPotentials(const std::string& field, const std::string& unit) {
+        std::ifstream in(field);
+        if (!in || m_nodes.empty()) {
+            std::cerr << "ComponentComsolCached::ReadPotentials: Could not read " << field << "." << std::endl;
+            return false;
+        }
+        const double scale = UnitScale(unit);
+        const NodeGrid grid(m_nodes);
+        std::vector<double> pot(m_nodes.size(), 0.);
+        std::vector<char> matched(m_nodes.size(), 0);
+        size_t nMatched = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '%') continue;
+            const char* p = line.c_str();
+            char* end = nullptr;
+            double values[4];
+            unsigned int n = 0;
+            for (; n < 4; ++n) {
+                values[n] = std::strtod(p, &end);
+                if (end == p) break;
+                p = end;
+            }
+            if (n < 4) continue;
+            const double x = values[0] * scale, y = values[1] * scale, z = values[2] * scale;
+            if (!grid.Inside(x, y, z)) {
+                std::cerr << "ComponentComsolCached::ReadPotentials: " << field
+                          << " has points outside the mesh (wrong unit?)." << std::endl;
+                return false;
+            }
+            const size_t node = grid.Nearest(m_nodes, x, y, z);
+            if (matched[node]) continue;
+            matched[node] = 1;
+            pot[node] = values[3];
+            ++nMatched;
+        }
+        if (nMatched != m_nodes.size()) {
+            std::cerr << "ComponentComsolCached::ReadPotentials: " << field << " has potentials for "
+                      << nMatched << " of the " << m_nodes.size() << " nodes of the mesh." << std::endl;
+            return false;
+        }
+        m_pot.swap(pot);
+        UpdatePotentialRange();
+        m_sums.field = FileStamp(field);
+        return true;
+    }
+
+    // Make sure there is an up-to-date cache of another field file on the
+    // loaded mesh, for LoadPotentials. An existing cache is checked from its
+    // header only; a missing or stale one is written from the loaded mesh and
+    // the potentials of the field file. The loaded potentials are kept.
+    bool MakePotentialCache(const std::string& cache, const std::string& field, const std::string& unit) {
+        Checksums sums = m_sums;
+        sums.field = FileStamp(field);
+        if (IsCurrent(cache, sums)) return true;
+
+        std::cout << "ComponentComsolCached::MakePotentialCache: No valid cache in " << cache
+                  << ", reading the potentials of " << field << "." << std::endl;
+        const std::vector<double> pot = m_pot;
+        const Checksums loaded = m_sums;
+        const bool ok = ReadPotentials(field, unit) && WriteCache(cache, sums);
+        m_pot = pot;
+        UpdatePotentialRange();
+        m_sums = loaded;
+        return ok;
+    }
+
+    // Checksum (64-bit FNV-1a) of the size and modification time of a source
+    // file. Only stat is needed, so checking a cache does not read the file;
+    // copies of the source files must keep their times (cp -p) to match.
+    static uint64_t FileStamp(const std::string& filename) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) return 0;
+        const uint64_t words[3] = {static_cast<uint64_t>(st.st_size), static_cast<uint64_t>(st.st_mtim.tv_sec),
+                                   static_cast<uint64_t>(st.st_mtim.tv_nsec)};
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (const uint64_t w : words) h = (h ^ w) * 0x100000001b3ULL;
+        return h;
+    }
+
+    static uint64_t HashString(const std::string& s) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (const unsigned char c : s) h = (h ^ c) * 0x100000001b3ULL;
+        return h;
+    }
+
+    // Write the currently loaded map to a cache file for the given source
+    // files. The file is written under a temporary name and renamed, so jobs
+    // starting at the same time never see a half-written image.
+    bool WriteCache(const std::string& cache, const std::string& mesh,
+                    const std::string& mplist, const std::string& field,
+                    const std::string& unit) {
+        return WriteCache(cache, {FileStamp(mesh), FileStamp(mplist), FileStamp(field), HashString(unit)});
+    }
+
+  private:
+    static constexpr uint32_t kVersion = 2;
+    static constexpr char kMagic[8] = {'G', 'F', 'C', 'O', 'M', 'S', 'O', 'L'};
+
+    struct Checksums {
+        uint64_t mesh = 0, mplist = 0, field = 0, unit = 0;
+    };
+    Checksums m_sums;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        // Layout of Garfield's structs, to catch images from another build
+        uint32_t elementSize;
+        uint32_t nodeSize;
+        uint32_t materialSize;
+        uint64_t meshHash, mplistHash, fieldHash, unitHash;
+        int32_t elementType;
+        int32_t is3d;
+        uint64_t nNodes, nElements, nMaterials;
+        // Byte offsets of the arrays from the start of the file
+        uint64_t offNodes, offElements, offMaterials, offPot;
+    };
+
+    struct MaterialRecord {
+        double eps;
+        double ohm;
+        int32_t driftmedium;
+        int32_t pad;
+    };
+
+    struct MappedFile {
+        const char* data = nullptr;
+        size_t size = 0;
+
+        bool Open(const std::string& filename) {
+            const int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+                close(fd);
+                return false;
+            }
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED) return false;
+            data = static_cast<const char*>(p);
+            size = st.st_size;
+            return true;
+        }
+
+        const Header* GetHeader() const {
+            const Header* h = reinterpret_cast<const Header*>(data);
+            if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kVersion ||
+                h->elementSize != sizeof(Element) || h->nodeSize != sizeof(Node) ||
+                h->materialSize != sizeof(MaterialRecord)) {
+                return nullptr;
+            }
+            if (h->offPot + h->nNodes * sizeof(double) > size) return nullptr;
+            return h;
+        }
+
+        ~MappedFile() {
+            if (data) munmap(const_cast<char*>(data), size);
+        }
+    };
+
+    static uint64_t Align(uint64_t offset) { return (offset + 63) & ~uint64_t(63); }
+
+    // Length unit of the COMSOL files in cm
+    static double UnitScale(const std::string& unit) {
+        if (unit == "mum" || unit == "um" || unit == "micron" || unit == "micrometer") return 1.e-4;
+        if (unit == "mm" || unit == "millimeter") return 0.1;
+        if (unit == "m" || unit == "meter") return 100.;
+        return 1.;
+    }
+
+    // Nodes sorted into a regular grid of cubic cells with about one node
+    // each, to find the node nearest to a point of a field file
+    class NodeGrid {
+      public:
+        explicit NodeGrid(const std::vector<Node>& nodes) {
+            m_min[0] = m_max[0] = nodes[0].x;
+            m_min[1] = m_max[1] = nodes[0].y;
+            m_min[2] = m_max[2] = nodes[0].z;
+            for (const auto& node : nodes) {
+                const double c[3] = {node.x, node.y, node.z};
+                for (unsigned int a = 0; a < 3; ++a) {
+                    m_min[a] = std::min(m_min[a], c[a]);
+                    m_max[a] = std::max(m_max[a], c[a]);
+                }
+            }
+            double volume = 1.;
+            for (unsigned int a = 0; a < 3; ++a) volume *= std::max(m_max[a] - m_min[a], 1.e-12);
+            m_cell = std::cbrt(volume / nodes.size());
+            size_t nCells = 1;
+            for (unsigned int a = 0; a < 3; ++a) {
+                m_n[a] = std::max(1, static_cast<int>(std::ceil((m_max[a] - m_min[a]) / m_cell)));
+                nCells *= m_n[a];
+            }
+            // Nodes of each cell next to each other (counting sort)
+            m_start.assign(nCells + 1, 0);
+            std::vector<size_t> cells(nodes.size());
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                cells[i] = Cell(Index(nodes[i].x, 0), Index(nodes[i].y, 1), Index(nodes[i].z, 2));
+                ++m_start[cells[i] + 1];
+            }
+            for (size_t c = 1; c < m_start.size(); ++c) m_start[c] += m_start[c - 1];
+            m_nodes.resize(nodes.size());
+            std::vector<size_t> fill(m_start.begin(), m_start.end() - 1);
+            for (size_t i = 0; i < nodes.size(); ++i) m_nodes[fill[cells[i]]++] = i;
+        }
+
+        // Whether a point is inside the bounding box of the nodes (give or take a cell)
+        bool Inside(double x, double y, double z) const {
+            const double c[3] = {x, y, z};
+            for (unsigned int a = 0; a < 3; ++a) {
+                if (c[a] < m_min[a] - m_cell || c[a] > m_max[a] + m_cell) return false;
+            }
+            return true;
+        }
+
+        // Search shells of cells around the point until no closer node can
+        // be outside the ones searched
+        size_t Nearest(const std::vector<Node>& nodes, double x, double y, double z) const {
+            const int c0[3] = {Index(x, 0), Index(y, 1), Index(z, 2)};
+            const int maxShell = std::max({m_n[0], m_n[1], m_n[2]});
+            size_t best = 0;
+            double bestDist = INFINITY;
+            auto search = [&](int i, int j, int k) {
+                const size_t c = Cell(i, j, k);
+                for (size_t m = m_start[c]; m < m_start[c + 1]; ++m) {
+                    const Node& node = nodes[m_nodes[m]];
+                    const double d = (node.x - x) * (node.x - x) + (node.y - y) * (node.y - y) +
+                                     (node.z - z) * (node.z - z);
+                    if (d < bestDist) {
+                        bestDist = d;
+                        best = m_nodes[m];
+                    }
+                }
+            };
+            for (int shell = 0; shell <= maxShell; ++shell) {
+                const int i0 = std::max(0, c0[0] - shell), i1 = std::min(m_n[0] - 1, c0[0] + shell);
+                const int j0 = std::max(0, c0[1] - shell), j1 = std::min(m_n[1] - 1, c0[1] + shell);
+                for (int i = i0; i <= i1; ++i) {
+                    for (int j = j0; j <= j1; ++j) {
+                        if (std::abs(i - c0[0]) == shell || std::abs(j - c0[1]) == shell) {
+                            const int k0 = std::max(0, c0[2] - shell), k1 = std::min(m_n[2] - 1, c0[2] + shell);
+                            for (int k = k0; k <= k1; ++k) search(i, j, k);
+                        } else {
+                            if (c0[2] - shell >= 0) search(i, j, c0[2] - shell);
+                            if (shell > 0 && c0[2] + shell < m_n[2]) search(i, j, c0[2] + shell);
+                        }
+                    }
+                }
+                if (bestDist <= shell * shell * m_cell * m_cell) break;
+            }
+            return best;
+        }
+
+      private:
+        double m_min[3], m_max[3];
+        double m_cell;
+        int m_n[3];
+        std::vector<size_t> m_start;
+        std::vector<size_t> m_nodes;
+
+        int Index(double x, unsigned int a) const {
+            return std::min(m_n[a] - 1, std::max(0, static_cast<int>((x - m_min[a]) / m_cell)));
+        }
+        size_t Cell(int i, int j, int k) const { return (size_t(k) * m_n[1] + j) * m_n[0] + i; }
+    };
+
+    // Whether the header of a cache matches the mesh, the source files and the unit
+    bool IsCurrent(const std::string& cache, const Checksums& sums) const {
+        MappedFile f;
+        if (!f.Open(cache)) return false;
+        const Header* h = f.GetHeader();
+        return h && h->nNodes == m_nodes.size() && h->nElements == m_elements.size() &&
+               h->meshHash == sums.mesh && h->mplistHash == sums.mplist &&
+               h->fieldHash == sums.field && h->unitHash == sums.unit;
+    }
+
+    // Range of the potentials, which ComponentComsol sets when it reads them
+    void UpdatePotentialRange() {
+        if (m_pot.empty()) return;
+        const auto range = std::minmax_element(m_pot.begin(), m_pot.end());
+        m_pMin = *range.first;
+        m_pMax = *range.second;
+    }
+
+    bool LoadCache(const std::string& cache, const Checksums& sums) {
+        MappedFile f;
+        if (!f.Open(cache)) return false;
+        const Header* h = f.GetHeader();
+        if (!h) {
+            std::cout << "ComponentComsolCached::LoadCache: " << cache
+                      << " was written by another version, ignoring it." << std::endl;
+            return false;
+        }
+        if (h->meshHash != sums.mesh || h->mplistHash != sums.mplist ||
+            h->fieldHash != sums.field || h->unitHash != sums.unit) {
+            std::cout << "ComponentComsolCached::LoadCache: " << cache
+                      << " is stale, ignoring it." << std::endl;
+            return false;
+        }
+
+        Reset();
+        const Node* nodes = reinterpret_cast<const Node*>(f.data + h->offNodes);
+        m_nodes.assign(nodes, nodes + h->nNodes);
+        const Element* elements = reinterpret_cast<const Element*>(f.data + h->offElements);
+        m_elements.assign(elements, elements + h->nElements);
+        const MaterialRecord* materials = reinterpret_cast<const MaterialRecord*>(f.data + h->offMaterials);
+        m_materials.clear();
+        for (uint64_t i = 0; i < h->nMaterials; ++i) {
+            Material mat;
+            mat.eps = materials[i].eps;
+            mat.ohm = materials[i].ohm;
+            mat.driftmedium = materials[i].driftmedium != 0;
+            mat.medium = nullptr;
+            m_materials.push_back(mat);
+        }
+        const double* pot = reinterpret_cast<const double*>(f.data + h->offPot);
+        m_pot.assign(pot, pot + h->nNodes);
+        UpdatePotentialRange();
+        m_elementType = static_cast<decltype(m_elementType)>(h->elementType);
+        m_is3d = h->is3d != 0;
+        m_sums = sums;
+
+        std::cout << "ComponentComsolCached::LoadCache: Read " << m_nodes.size() << " nodes and "
+                  << m_elements.size() << " elements from " << cache << "." << std::endl;
+        m_ready = true;
+        Prepare();
+        return true;
+    }
+
+    bool WriteCache(const std::string& cache, const Checksums& sums) {
+        m_sums = sums;
+
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version = kVersion;
+        h.elementSize = sizeof(Element);
+        h.nodeSize = sizeof(Node);
+        h.materialSize = sizeof(MaterialRecord);
+        h.meshHash = sums.mesh;
+        h.mplistHash = sums.mplist;
+        h.fieldHash = sums.field;
+        h.unitHash = sums.unit;
+        h.elementType = static_cast<int32_t>(m_elementType);
+        h.is3d = m_is3d ? 1 : 0;
+        h.nNodes = m_nodes.size();
+        h.nElements = m_elements.size();
+        h.nMaterials = m_materials.size();
+        h.offNodes = Align(sizeof(Header));
+        h.offElements = Align(h.offNodes + h.nNodes * sizeof(Node));
+        h.offMaterials = Align(h.offElements + h.nElements * sizeof(Element));
+        h.offPot = Align(h.offMaterials + h.nMaterials * sizeof(MaterialRecord));
+
+        std::vector<MaterialRecord> materials;
+        for (const auto& mat : m_materials) {
+            materials.push_back({mat.eps, mat.ohm, mat.driftmedium ? 1 : 0, 0});
+        }
+
+        const std::string tmp = cache + ".tmp." + std::to_string(getpid());
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) {
+            std::cerr << "ComponentComsolCached::WriteCache: Could not write " << tmp << "." << std::endl;
+            return false;
+        }
+        auto section = [&](uint64_t offset, const void* data, size_t bytes) {
+            const std::string pad(offset - static_cast<uint64_t>(out.tellp()), '\0');
+            out.write(pad.data(), pad.size());
+            out.write(static_cast<const char*>(data), bytes);
+        };
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        section(h.offNodes, m_nodes.data(), m_nodes.size() * sizeof(Node));
+        section(h.offElements, m_elements.data(), m_elements.size() * sizeof(Element));
+        section(h.offMaterials, materials.data(), materials.size() * sizeof(MaterialRecord));
+        section(h.offPot, m_pot.data(), m_pot.size() * sizeof(double));
+        out.close();
+        if (!out || std::rename(tmp.c_str(), cache.c_str()) != 0) {
+            std::cerr << "ComponentComsolCached::WriteCache: Could not write " << cache << "." << std::endl;
+            std::remove(tmp.c_str());
+            return false;
+        }
+        std::cout << "ComponentComsolCached::WriteCache: Wrote " << cache << "." << std::endl;
+        return true;
+    }
+};
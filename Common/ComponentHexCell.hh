@@ -0,0 +1,290 @@
+// Electric field of a periodic hexagonal mesh geometry, served from a regular
+// 3D grid covering one hexagonal unit cell.
+//
+// Microscopic tracking evaluates the field at every step, and for a COMSOL
+// map each evaluation is a search for the enclosing tetrahedron. Here the FEM
+// solution is sampled once onto a regular grid; a query folds (x, y) back into
+// the central cell with the axial (q, r) hexagon coordinates of
+// CalcTrackRes.py and interpolates the 8 surrounding grid nodes trilinearly,
+// with (ex, ey, ez, v) packed in one 4-wide vector per node.
+//
+// The hexagons are "pointy top" with the centre-to-corner distance hexsize,
+// optionally rotated by an angle about the z axis. Validate() reports how far
+// the grid is from the FEM answer at a given resolution.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Garfield/Component.hh"
+#include "Garfield/Medium.hh"
+
+class ComponentHexCell : public Garfield::Component {
+  public:
+    ComponentHexCell() : Garfield::Component("HexCell") {}
+
+    // Size (centre to corner) [cm] and rotation [deg] of the hexagons
+    void SetHexagon(double size, double rotation = 0.) {
+        m_size = size;
+        m_cos = std::cos(rotation * M_PI / 180.);
+        m_sin = std::sin(rotation * M_PI / 180.);
+    }
+
+    // Distance between grid nodes [cm] and the z range covered by the grid
+    void SetGrid(double spacing, double zmin, double zmax) {
+        m_spacing = spacing;
+        m_zmin = zmin;
+        m_zmax = zmax;
+    }
+
+    // Sample the field of the FEM map on the grid. The grid spans a square of
+    // half width hexsize around the cell centre (plus one node of margin), so
+    // it contains the folded cell for any rotation.
+    bool Sample(Garfield::Component* fem) {
+        if (!fem || m_size <= 0. || m_spacing <= 0. || m_zmax <= m_zmin) {
+            std::cerr << "ComponentHexCell::Sample: Hexagon or grid not set." << std::endl;
+            return false;
+        }
+        m_fem = fem;
+        double x0, y0, z0, x1, y1, z1;
+        m_hasBox = fem->GetBoundingBox(x0, y0, z0, x1, y1, z1);
+        m_box = {x0, y0, z0, x1, y1, z1};
+
+        m_xmin = -m_size - m_spacing;
+        m_ymin = m_xmin;
+        m_nx = static_cast<unsigned int>(std::ceil(2. * (m_size + m_spacing) / m_spacing)) + 1;
+        m_ny = m_nx;
+        m_nz = static_cast<unsigned int>(std::ceil((m_zmax - m_zmin) / m_spacing)) + 1;
+        m_dz = (m_zmax - m_zmin) / (m_nz - 1);
+
+        std::cout << "ComponentHexCell::Sample: " << m_nx << " x " << m_ny << " x " << m_nz
+                  << " nodes with a spacing of " << m_spacing * 1.e4 << " um." << std::endl;
+
+        m_nodes.assign(size_t(m_nx) * m_ny * m_nz, v4sf{0.f, 0.f, 0.f, 0.f});
+        m_mediumIndex.assign(m_nodes.size(), 0);
+        m_media.assign(1, nullptr);
+        m_vmin = m_vmax = 0.;
+        bool first = true;
+        for (unsigned int k = 0; k < m_nz; ++k) {
+            const double z = m_zmin + k * m_dz;
+            for (unsigned int j = 0; j < m_ny; ++j) {
+                const double y = m_ymin + j * m_spacing;
+                for (unsigned int i = 0; i < m_nx; ++i) {
+                    const double x = m_xmin + i * m_spacing;
+                    double ex = 0., ey = 0., ez = 0., v = 0.;
+                    Garfield::Medium* m = nullptr;
+                    int status = 0;
+                    fem->ElectricField(x, y, z, ex, ey, ez, v, m, status);
+                    if (status != 0 && status != -5) m = nullptr;
+                    const size_t n = Index(i, j, k);
+                    m_nodes[n] = v4sf{float(ex), float(ey), float(ez), float(v)};
+                    m_mediumIndex[n] = MediumIndex(m);
+                    if (!m) continue;
+                    if (first || v < m_vmin) m_vmin = v;
+                    if (first || v > m_vmax) m_vmax = v;
+                    first = false;
+                }
+            }
+        }
+        m_ready = true;
+        return true;
+    }
+
+    // Compare the grid with the FEM map at n random points inside the FEM
+    // bounding box (in drift medium, inside the grid's z range). Returns the
+    // largest deviation of |E| relative to the FEM value.
+    double Validate(unsigned int n, unsigned int seed = 1) {
+        if (!m_ready || !m_hasBox) return -1.;
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> ux(m_box[0], m_box[3]);
+        std::uniform_real_distribution<double> uy(m_box[1], m_box[4]);
+        std::uniform_real_distribution<double> uz(std::max(m_zmin, m_box[2]), std::min(m_zmax, m_box[5]));
+
+        double maxAbs = 0., maxRel = 0., sumRel = 0.;
+        double worst[3] = {0., 0., 0.};
+        unsigned int nUsed = 0;
+        for (unsigned int i = 0; i < n; ++i) {
+            const double x = ux(rng), y = uy(rng), z = uz(rng);
+            double ex0, ey0, ez0, v0;
+            Garfield::Medium* m0 = nullptr;
+            int status0 = 0;
+            m_fem->ElectricField(x, y, z, ex0, ey0, ez0, v0, m0, status0);
+            if (status0 != 0 || !m0) continue;
+            double ex1, ey1, ez1, v1;
+            Garfield::Medium* m1 = nullptr;
+            int status1 = 0;
+            ElectricField(x, y, z, ex1, ey1, ez1, v1, m1, status1);
+            if (status1 != 0) continue;
+
+            const double e0 = std::sqrt(ex0 * ex0 + ey0 * ey0 + ez0 * ez0);
+            const double dev = std::sqrt((ex1 - ex0) * (ex1 - ex0) + (ey1 - ey0) * (ey1 - ey0) +
+                                         (ez1 - ez0) * (ez1 - ez0));
+            const double rel = e0 > 0. ? dev / e0 : 0.;
+            maxAbs = std::max(maxAbs, dev);
+            if (rel > maxRel) {
+                maxRel = rel;
+                worst[0] = x;
+                worst[1] = y;
+                worst[2] = z;
+            }
+            sumRel += rel;
+            ++nUsed;
+        }
+        std::cout << "ComponentHexCell::Validate: " << nUsed << " points compared with the FEM map.\n"
+                  << "    Max. deviation: " << maxAbs << " V/cm\n"
+                  << "    Max. relative deviation: " << maxRel << " at (" << worst[0] << ", "
+                  << worst[1] << ", " << worst[2] << ")\n"
+                  << "    Mean relative deviation: " << (nUsed > 0 ? sumRel / nUsed : 0.) << std::endl;
+        return maxRel;
+    }
+
+    // Move (x, y) into the central hexagon
+    void Fold(double& x, double& y) const {
+        // Rotate into the frame of the lattice
+        const double xl = m_cos * x + m_sin * y;
+        const double yl = -m_sin * x + m_cos * y;
+        // Axial coordinates, as in CalcTrackRes.py
+        const double q = (xl * std::sqrt(3.) / 3. - yl / 3.) / m_size;
+        const double r = (2. / 3.) * yl / m_size;
+        int nq, nr;
+        HexRound(q, r, nq, nr);
+        // Translate by the lattice vector of that hexagon (in the rotated frame)
+        const double dxl = m_size * std::sqrt(3.) * (nq + 0.5 * nr);
+        const double dyl = m_size * 1.5 * nr;
+        x -= m_cos * dxl - m_sin * dyl;
+        y -= m_sin * dxl + m_cos * dyl;
+    }
+
+    // Nearest hexagon centre of (q, r), in axial coordinates
+    static void HexRound(double q, double r, int& qi, int& ri) {
+        const double s = -q - r;
+        qi = static_cast<int>(std::round(q));
+        ri = static_cast<int>(std::round(r));
+        int si = static_cast<int>(std::round(s));
+        const double qDiff = std::abs(qi - q);
+        const double rDiff = std::abs(ri - r);
+        const double sDiff = std::abs(si - s);
+        if (qDiff > rDiff && qDiff > sDiff) {
+            qi = -ri - si;
+        } else if (rDiff > sDiff) {
+            ri = -qi - si;
+        }
+    }
+
+    void ElectricField(const double x, const double y, const double z, double& ex, double& ey,
+                       double& ez, Garfield::Medium*& m, int& status) override {
+        double v = 0.;
+        ElectricField(x, y, z, ex, ey, ez, v, m, status);
+    }
+
+    void ElectricField(const double x, const double y, const double z, double& ex, double& ey,
+                       double& ez, double& v, Garfield::Medium*& m, int& status) override {
+        ex = ey = ez = v = 0.;
+        m = nullptr;
+        if (!m_ready || z < m_zmin || z > m_zmax) {
+            status = -6;
+            return;
+        }
+        double xf = x, yf = y;
+        Fold(xf, yf);
+
+        // Cell of the grid and the position inside it
+        const double fx = (xf - m_xmin) / m_spacing;
+        const double fy = (yf - m_ymin) / m_spacing;
+        const double fz = (z - m_zmin) / m_dz;
+        const unsigned int i = std::min(static_cast<unsigned int>(fx), m_nx - 2);
+        const unsigned int j = std::min(static_cast<unsigned int>(fy), m_ny - 2);
+        const unsigned int k = std::min(static_cast<unsigned int>(fz), m_nz - 2);
+        const float tx = fx - i, ty = fy - j, tz = fz - k;
+
+        const size_t n000 = Index(i, j, k);
+        const size_t dy = m_nx;
+        const size_t dz = size_t(m_nx) * m_ny;
+        const v4sf* p = m_nodes.data();
+        const v4sf c00 = p[n000] + (p[n000 + 1] - p[n000]) * tx;
+        const v4sf c10 = p[n000 + dy] + (p[n000 + dy + 1] - p[n000 + dy]) * tx;
+        const v4sf c01 = p[n000 + dz] + (p[n000 + dz + 1] - p[n000 + dz]) * tx;
+        const v4sf c11 = p[n000 + dz + dy] + (p[n000 + dz + dy + 1] - p[n000 + dz + dy]) * tx;
+        const v4sf c0 = c00 + (c10 - c00) * ty;
+        const v4sf c1 = c01 + (c11 - c01) * ty;
+        const v4sf f = c0 + (c1 - c0) * tz;
+        ex = f[0];
+        ey = f[1];
+        ez = f[2];
+        v = f[3];
+
+        // Medium of the nearest node
+        const size_t nn = Index(i + (tx > 0.5f), j + (ty > 0.5f), k + (tz > 0.5f));
+        m = m_media[m_mediumIndex[nn]];
+        if (!m) {
+            status = -6;
+        } else if (!m->IsDriftable()) {
+            status = -5;
+        } else {
+            status = 0;
+        }
+    }
+
+    Garfield::Medium* GetMedium(const double x, const double y, const double z) override {
+        double ex, ey, ez;
+        Garfield::Medium* m = nullptr;
+        int status = 0;
+        ElectricField(x, y, z, ex, ey, ez, m, status);
+        return m;
+    }
+
+    bool GetVoltageRange(double& vmin, double& vmax) override {
+        vmin = m_vmin;
+        vmax = m_vmax;
+        return m_ready;
+    }
+
+    // Same area as the FEM map it was sampled from
+    bool GetBoundingBox(double& xmin, double& ymin, double& zmin, double& xmax, double& ymax,
+                        double& zmax) override {
+        if (!m_hasBox) return false;
+        xmin = m_box[0];
+        ymin = m_box[1];
+        zmin = std::max(m_box[2], m_zmin);
+        xmax = m_box[3];
+        ymax = m_box[4];
+        zmax = std::min(m_box[5], m_zmax);
+        return true;
+    }
+
+  private:
+    typedef float v4sf __attribute__((vector_size(16)));
+
+    double m_size = 0.;
+    double m_cos = 1., m_sin = 0.;
+    double m_spacing = 0.;
+    double m_zmin = 0., m_zmax = 0.;
+
+    Garfield::Component* m_fem = nullptr;
+    bool m_hasBox = false;
+    std::vector<double> m_box = std::vector<double>(6, 0.);
+
+    unsigned int m_nx = 0, m_ny = 0, m_nz = 0;
+    double m_xmin = 0., m_ymin = 0., m_dz = 0.;
+    double m_vmin = 0., m_vmax = 0.;
+
+    // (ex, ey, ez, v) at each node, x running fastest
+    std::vector<v4sf> m_nodes;
+    std::vector<uint8_t> m_mediumIndex;
+    std::vector<Garfield::Medium*> m_media;
+
+    size_t Index(unsigned int i, unsigned int j, unsigned int k) const {
+        return (size_t(k) * m_ny + j) * m_nx + i;
+    }
+
+    uint8_t MediumIndex(Garfield::Medium* m) {
+        const auto it = std::find(m_media.begin(), m_media.end(), m);
+        if (it != m_media.end()) return it - m_media.begin();
+        m_media.push_back(m);
+        return m_media.size() - 1;
+    }
+};
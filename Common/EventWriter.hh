@@ -0,0 +1,270 @@
+// Streaming writer for the per-avalanche output of the electroluminescence
+// drivers. Every avalanche is appended as soon as it is collected, so memory
+// use is bounded by one avalanche plus the ones waiting in the WorkerPool
+// window, not by the job. The file is flushed every chunk of rows or every
+// minute (and at Close), so a job that dies half way loses at most that much
+// while partly filled chunks are not recompressed after every avalanche.
+//
+// HDF5 layout (one 1D column per quantity, read with ReadEventInfo.py):
+//   /EventInfo/{event, x, y, z, t}
+//   /Metadata/{event, electrons, ions, elastic, ionisations, attachment,
+//              inelastic, excitation, top, bottom, start_x, start_y, start_z,
+//              start_E, end_E}
+// With quantisation enabled x, y, z, t are stored as integers in units of
+// 1e-3 (the precision of roundDP), which deflate compresses well; the scale
+// is stored in the "scale" attribute of each column.
+//
+// The CSV format writes the same EventInfo/Metadata text files as before.
+//
+// The Summary format (output=summary) keeps only the /Metadata table, in
+// Summary<suffix>.h5, and adds the profiles and moments of ExcitationSummary.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "AvalancheRecord.hh"
+#include "ExcitationSummary.hh"
+
+// Round to three decimal places to save on space in the file
+inline float roundDP(float var)
+{
+    // 37.66666 * 100 =3766.66
+    // 3766.66 + .5 =3767.16    for rounding off value
+    // then type cast to int so value is 3767
+    // then divided by 100 so the value converted into 37.67
+    float value = (int)(var * 1000 + .5);
+    return (float)value / 1000;
+}
+
+// roundDP as an integer number of 1e-3 units
+inline int32_t quantiseDP(float var) { return (int)(var * 1000 + .5); }
+
+// Extendable, chunked and compressed 1D dataset
+class H5Column {
+  public:
+    H5Column(hid_t group, const std::string& name, hid_t type, hsize_t chunk) : m_type(type) {
+        const hsize_t dims[1] = {0};
+        const hsize_t maxdims[1] = {H5S_UNLIMITED};
+        const hsize_t chunkdims[1] = {chunk};
+        hid_t space = H5Screate_simple(1, dims, maxdims);
+        hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(plist, 1, chunkdims);
+        if (H5Zfilter_avail(H5Z_FILTER_DEFLATE)) {
+            H5Pset_shuffle(plist);
+            H5Pset_deflate(plist, 4);
+        }
+        m_dset = H5Dcreate2(group, name.c_str(), type, space, H5P_DEFAULT, plist, H5P_DEFAULT);
+        H5Pclose(plist);
+        H5Sclose(space);
+    }
+
+    ~H5Column() {
+        if (m_dset >= 0) H5Dclose(m_dset);
+    }
+
+    H5Column(const H5Column&) = delete;
+    H5Column& operator=(const H5Column&) = delete;
+
+    // Attach a double attribute (e.g. the quantisation scale)
+    void SetAttribute(const std::string& name, double value) {
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr = H5Acreate2(m_dset, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT);
+        H5Awrite(attr, H5T_NATIVE_DOUBLE, &value);
+        H5Aclose(attr);
+        H5Sclose(space);
+    }
+
+    // Append n values of the column's type
+    void Append(const void* data, hsize_t n) {
+        if (n == 0) return;
+        const hsize_t newsize[1] = {m_size + n};
+        H5Dset_extent(m_dset, newsize);
+        hid_t fspace = H5Dget_space(m_dset);
+        const hsize_t start[1] = {m_size};
+        const hsize_t count[1] = {n};
+        H5Sselect_hyperslab(fspace, H5S_SELECT_SET, start, nullptr, count, nullptr);
+        hid_t mspace = H5Screate_simple(1, count, nullptr);
+        H5Dwrite(m_dset, m_type, mspace, fspace, H5P_DEFAULT, data);
+        H5Sclose(mspace);
+        H5Sclose(fspace);
+        m_size += n;
+    }
+
+    template <typename T>
+    void Append(const T& value) { Append(&value, 1); }
+
+    hsize_t Size() const { return m_size; }
+
+  private:
+    hid_t m_dset = -1;
+    hid_t m_type;
+    hsize_t m_size = 0;
+};
+
+class EventWriter {
+  public:
+    enum class Format { CSV, HDF5, Summary };
+
+    // Output goes to EventInfo<suffix>.h5, EventInfo<suffix>.csv and
+    // Metadata<suffix>.csv, or Summary<suffix>.h5.
+    EventWriter(const std::string& suffix, Format format, bool quantise = true,
+                size_t chunkSize = 1 << 16)
+        : m_format(format), m_quantise(quantise), m_chunkSize(chunkSize) {
+
+        if (m_format == Format::CSV) {
+            m_eventFile.open("EventInfo" + suffix + ".csv");
+            m_metaFile.open("Metadata" + suffix + ".csv");
+            return;
+        }
+
+        const std::string filename = (m_format == Format::Summary ? "Summary" : "EventInfo") + suffix + ".h5";
+        m_file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        if (m_file < 0) {
+            std::cerr << "EventWriter: Could not create " << filename << std::endl;
+            return;
+        }
+        if (m_format == Format::HDF5) CreateEventColumns();
+        CreateMetadataColumns();
+    }
+
+    ~EventWriter() { Close(); }
+
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+
+    // Write one avalanche; flushed to disk with the next chunk of rows
+    void Write(const AvalancheRecord& rec) {
+        if (m_format == Format::CSV) {
+            WriteCSV(rec);
+        } else if (m_file >= 0) {
+            WriteHDF5(rec);
+        }
+    }
+
+    // Write the profiles and moments of the job (Summary format, before Close)
+    void WriteSummary(const ExcitationSummary& summary) {
+        if (m_format != Format::Summary || m_file < 0) return;
+        summary.Write(m_file);
+    }
+
+    void Close() {
+        m_columns.clear();
+        m_metaColumns.clear();
+        if (m_file >= 0) {
+            H5Fclose(m_file);
+            m_file = -1;
+        }
+        if (m_eventFile.is_open()) m_eventFile.close();
+        if (m_metaFile.is_open()) m_metaFile.close();
+    }
+
+  private:
+    Format m_format;
+    bool m_quantise;
+    size_t m_chunkSize;
+
+    std::ofstream m_eventFile;
+    std::ofstream m_metaFile;
+
+    hid_t m_file = -1;
+    // event, x, y, z, t
+    std::vector<std::unique_ptr<H5Column>> m_columns;
+    std::vector<std::unique_ptr<H5Column>> m_metaColumns;
+
+    // Scratch buffer for the quantised columns of one avalanche
+    std::vector<int32_t> m_ibuf;
+
+    // Rows (excitations, or avalanches in the Summary format) at the last flush
+    hsize_t m_flushedRows = 0;
+    std::chrono::steady_clock::time_point m_lastFlush = std::chrono::steady_clock::now();
+    static constexpr double kFlushInterval = 60.; // s
+    // Metadata rows are few, use smaller chunks
+    static constexpr hsize_t kMetaChunk = 1024;
+
+    void CreateEventColumns() {
+        hid_t events = H5Gcreate2(m_file, "EventInfo", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        const hid_t posType = m_quantise ? H5T_NATIVE_INT32 : H5T_NATIVE_FLOAT;
+        m_columns.emplace_back(new H5Column(events, "event", H5T_NATIVE_INT32, m_chunkSize));
+        for (const char* name : {"x", "y", "z", "t"}) {
+            m_columns.emplace_back(new H5Column(events, name, posType, m_chunkSize));
+            if (m_quantise) m_columns.back()->SetAttribute("scale", 1.e-3);
+        }
+        H5Gclose(events);
+    }
+
+    void CreateMetadataColumns() {
+        hid_t meta = H5Gcreate2(m_file, "Metadata", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        for (const char* name : {"event", "electrons", "ions"}) {
+            m_metaColumns.emplace_back(new H5Column(meta, name, H5T_NATIVE_INT32, kMetaChunk));
+        }
+        for (const char* name : {"elastic", "ionisations", "attachment", "inelastic",
+                                 "excitation", "top", "bottom"}) {
+            m_metaColumns.emplace_back(new H5Column(meta, name, H5T_NATIVE_UINT32, kMetaChunk));
+        }
+        for (const char* name : {"start_x", "start_y", "start_z", "start_E", "end_E"}) {
+            m_metaColumns.emplace_back(new H5Column(meta, name, H5T_NATIVE_DOUBLE, kMetaChunk));
+        }
+        H5Gclose(meta);
+    }
+
+    void WriteCSV(const AvalancheRecord& rec) {
+        const auto& exc = rec.excitations;
+        for (size_t i = 0; i < exc.size(); ++i) {
+            m_eventFile << rec.info.event << "," << roundDP(exc.x[i]) << "," << roundDP(exc.y[i]) << ","
+                        << roundDP(exc.z[i]) << "," << roundDP(exc.t[i]) << "\n";
+        }
+        m_metaFile << rec.MetadataLine() << "\n";
+        m_eventFile.flush();
+        m_metaFile.flush();
+    }
+
+    void WriteHDF5(const AvalancheRecord& rec) {
+        const auto& exc = rec.excitations;
+        const std::vector<float>* cols[4] = {&exc.x, &exc.y, &exc.z, &exc.t};
+        // No excitations in the Summary format
+        const size_t n = m_columns.empty() ? 0 : exc.size();
+
+        if (n > 0) {
+            m_ibuf.assign(n, rec.info.event);
+            m_columns[0]->Append(m_ibuf.data(), n);
+            for (unsigned int k = 0; k < 4; ++k) {
+                const float* src = cols[k]->data();
+                if (m_quantise) {
+                    for (size_t i = 0; i < n; ++i) m_ibuf[i] = quantiseDP(src[i]);
+                    m_columns[k + 1]->Append(m_ibuf.data(), n);
+                } else {
+                    m_columns[k + 1]->Append(src, n);
+                }
+            }
+        }
+
+        const AvalancheInfo& info = rec.info;
+        m_metaColumns[0]->Append(int32_t(info.event));
+        m_metaColumns[1]->Append(int32_t(info.ne));
+        m_metaColumns[2]->Append(int32_t(info.ni));
+        const uint32_t counts[7] = {info.nEl, info.nIon, info.nAtt, info.nInel,
+                                    info.nExc, info.nTopPlane, info.nBottomPlane};
+        for (unsigned int k = 0; k < 7; ++k) m_metaColumns[3 + k]->Append(counts[k]);
+        const double values[5] = {info.x0, info.y0, info.z0, info.e1, info.e2};
+        for (unsigned int k = 0; k < 5; ++k) m_metaColumns[10 + k]->Append(values[k]);
+
+        // Flushing writes out the partly filled chunks, which are compressed
+        // again when the next rows go in, so only do it once per chunk of rows
+        const hsize_t rows = m_columns.empty() ? m_metaColumns[0]->Size() : m_columns[0]->Size();
+        const hsize_t chunk = m_columns.empty() ? kMetaChunk : m_chunkSize;
+        const std::chrono::duration<double> sinceFlush = std::chrono::steady_clock::now() - m_lastFlush;
+        if (rows - m_flushedRows >= chunk || sinceFlush.count() >= kFlushInterval) {
+            H5Fflush(m_file, H5F_SCOPE_GLOBAL);
+            m_flushedRows = rows;
+            m_lastFlush = std::chrono::steady_clock::now();
+        }
+    }
+};
@@ -0,0 +1,249 @@
+// On-the-fly aggregation of the excitations of the electroluminescence
+// drivers (output=summary), for production runs that only need the profiles
+// and yields rather than every photon.
+//
+// The collision handle fills an AvalancheProfile in the worker: fixed-binned
+// histograms of the time and transverse distance from the first excitation of
+// the avalanche and of z, plus running moments of the transverse offsets.
+// Nothing is kept per photon. At the end of each avalanche the profile is
+// packed (only the filled bins) into the payload sent to the parent and
+// cleared, and the parent adds it to the ExcitationSummary of the job along
+// with the per-avalanche counts. The summary is written by EventWriter.
+//
+// HDF5 layout (read with load_summary in ReadEventInfo.py):
+//   /Profiles/{t, z, r}/edges, counts   bin edges and counts; the underflow
+//                                        and overflow are attributes of counts
+//   /Moments/<quantity>                  n, mean, std over the avalanches
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+#include "AvalancheRecord.hh"
+#include "RunningStats.hh"
+#include "WorkerPool.hh"
+
+// Histogram with fixed bins and integer counts. Bin 0 is the underflow and
+// bin n + 1 the overflow. The filled bins are tracked, so a sparse histogram
+// can be packed and cleared without going over all the bins.
+class ProfileHistogram {
+  public:
+    ProfileHistogram() = default;
+    ProfileHistogram(unsigned int n, double lo, double hi) { SetBinning(n, lo, hi); }
+
+    void SetBinning(unsigned int n, double lo, double hi) {
+        m_n = n;
+        m_lo = lo;
+        m_hi = hi;
+        m_scale = n / (hi - lo);
+        m_counts.assign(n + 2, 0);
+        m_filled.clear();
+    }
+
+    void Fill(double x) {
+        unsigned int bin = 0;
+        if (x >= m_hi) {
+            bin = m_n + 1;
+        } else if (x >= m_lo) {
+            bin = 1 + std::min(m_n - 1, static_cast<unsigned int>((x - m_lo) * m_scale));
+        }
+        if (m_counts[bin]++ == 0) m_filled.push_back(bin);
+    }
+
+    // Append the filled bins to the payload and clear them
+    void PackAndClear(std::string& payload) {
+        WorkerPool::Pack(payload, static_cast<uint32_t>(m_filled.size()));
+        for (const uint32_t bin : m_filled) {
+            WorkerPool::Pack(payload, bin);
+            WorkerPool::Pack(payload, m_counts[bin]);
+            m_counts[bin] = 0;
+        }
+        m_filled.clear();
+    }
+
+    // Add the bins packed by PackAndClear
+    void UnpackAdd(const std::string& payload, size_t& pos) {
+        uint32_t nFilled = 0;
+        WorkerPool::Unpack(payload, pos, nFilled);
+        for (uint32_t k = 0; k < nFilled; ++k) {
+            uint32_t bin = 0;
+            uint64_t count = 0;
+            WorkerPool::Unpack(payload, pos, bin);
+            WorkerPool::Unpack(payload, pos, count);
+            if (bin < m_counts.size()) m_counts[bin] += count;
+        }
+    }
+
+    unsigned int GetNumberOfBins() const { return m_n; }
+    double GetLowerEdge() const { return m_lo; }
+    double GetUpperEdge() const { return m_hi; }
+    const std::vector<uint64_t>& GetCounts() const { return m_counts; }
+
+  private:
+    unsigned int m_n = 0;
+    double m_lo = 0., m_hi = 1., m_scale = 1.;
+    std::vector<uint64_t> m_counts;
+    std::vector<uint32_t> m_filled;
+};
+
+// Binning of the profiles
+struct ProfileBinning {
+    unsigned int nBins = 1000;
+    double tmax = 10000.;          // [ns] after the first excitation
+    double zmin = -1., zmax = 1.;  // [cm]
+    double rmax = 0.5;             // [cm] from the first excitation
+};
+
+// Profile of the excitations of one avalanche, filled in the worker
+class AvalancheProfile {
+  public:
+    void SetBinning(const ProfileBinning& b) {
+        m_t.SetBinning(b.nBins, 0., b.tmax);
+        m_z.SetBinning(b.nBins, b.zmin, b.zmax);
+        m_r.SetBinning(b.nBins, 0., b.rmax);
+    }
+
+    void Add(double x, double y, double z, double t) {
+        if (m_n++ == 0) {
+            m_x1 = x;
+            m_y1 = y;
+            m_t1 = t;
+        }
+        const double dx = x - m_x1;
+        const double dy = y - m_y1;
+        m_t.Fill(t - m_t1);
+        m_z.Fill(z);
+        m_r.Fill(std::sqrt(dx * dx + dy * dy));
+        m_dx.Add(dx);
+        m_dy.Add(dy);
+    }
+
+    // Append the profile to the payload and start the next avalanche
+    void PackAndClear(std::string& payload) {
+        WorkerPool::Pack(payload, m_n);
+        WorkerPool::Pack(payload, m_dx);
+        WorkerPool::Pack(payload, m_dy);
+        m_t.PackAndClear(payload);
+        m_z.PackAndClear(payload);
+        m_r.PackAndClear(payload);
+        m_n = 0;
+        m_dx = RunningStats();
+        m_dy = RunningStats();
+    }
+
+  private:
+    uint64_t m_n = 0;
+    double m_x1 = 0., m_y1 = 0., m_t1 = 0.;
+    ProfileHistogram m_t, m_z, m_r;
+    RunningStats m_dx, m_dy;
+};
+
+// Profiles and per-avalanche moments of a job, accumulated in the parent
+class ExcitationSummary {
+  public:
+    void SetBinning(const ProfileBinning& b) {
+        m_t.SetBinning(b.nBins, 0., b.tmax);
+        m_z.SetBinning(b.nBins, b.zmin, b.zmax);
+        m_r.SetBinning(b.nBins, 0., b.rmax);
+    }
+
+    // Add an avalanche: its counts and the profile packed after them at pos
+    void Add(const AvalancheInfo& info, const std::string& payload, size_t& pos) {
+        uint64_t n = 0;
+        RunningStats dx, dy;
+        WorkerPool::Unpack(payload, pos, n);
+        WorkerPool::Unpack(payload, pos, dx);
+        WorkerPool::Unpack(payload, pos, dy);
+        m_t.UnpackAdd(payload, pos);
+        m_z.UnpackAdd(payload, pos);
+        m_r.UnpackAdd(payload, pos);
+
+        m_moments[kExcitation].Add(info.nExc);
+        m_moments[kPhotons].Add(n);
+        m_moments[kElectrons].Add(info.ne);
+        m_moments[kIons].Add(info.ni);
+        m_moments[kTop].Add(info.nTopPlane);
+        m_moments[kBottom].Add(info.nBottomPlane);
+        if (n > 1) {
+            m_moments[kWidthX].Add(dx.StdDev());
+            m_moments[kWidthY].Add(dy.StdDev());
+        }
+        m_moments[kOffsetX].Merge(dx);
+        m_moments[kOffsetY].Merge(dy);
+    }
+
+    void Write(hid_t file) const {
+        hid_t profiles = H5Gcreate2(file, "Profiles", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        WriteHistogram(profiles, "t", m_t);
+        WriteHistogram(profiles, "z", m_z);
+        WriteHistogram(profiles, "r", m_r);
+        H5Gclose(profiles);
+
+        hid_t moments = H5Gcreate2(file, "Moments", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        for (unsigned int k = 0; k < kNumberOfMoments; ++k) {
+            const double values[3] = {double(m_moments[k].n), m_moments[k].mean, m_moments[k].StdDev()};
+            WriteArray(moments, MomentName(k), values, 3);
+        }
+        H5Gclose(moments);
+    }
+
+  private:
+    // excitation: excitation collisions of the gas, photons: excitations seen
+    // by the collision handle, width_x/y: spread of the excitations of an
+    // avalanche, dx/dy: offsets of all excitations from the first one
+    enum Moment {
+        kExcitation, kPhotons, kElectrons, kIons, kTop, kBottom,
+        kWidthX, kWidthY, kOffsetX, kOffsetY, kNumberOfMoments
+    };
+
+    static const char* MomentName(unsigned int k) {
+        static const char* names[kNumberOfMoments] = {
+            "excitation", "photons", "electrons", "ions", "top", "bottom",
+            "width_x", "width_y", "dx", "dy"};
+        return names[k];
+    }
+
+    ProfileHistogram m_t, m_z, m_r;
+    RunningStats m_moments[kNumberOfMoments];
+
+    static void WriteArray(hid_t group, const std::string& name, const double* data, hsize_t n) {
+        hid_t space = H5Screate_simple(1, &n, nullptr);
+        hid_t dset = H5Dcreate2(group, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+        H5Dclose(dset);
+        H5Sclose(space);
+    }
+
+    static void WriteHistogram(hid_t parent, const std::string& name, const ProfileHistogram& h) {
+        hid_t group = H5Gcreate2(parent, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        const unsigned int n = h.GetNumberOfBins();
+        std::vector<double> edges(n + 1);
+        for (unsigned int i = 0; i <= n; ++i) {
+            edges[i] = h.GetLowerEdge() + i * (h.GetUpperEdge() - h.GetLowerEdge()) / n;
+        }
+        WriteArray(group, "edges", edges.data(), n + 1);
+
+        const auto& counts = h.GetCounts();
+        const hsize_t dims[1] = {n};
+        hid_t space = H5Screate_simple(1, dims, nullptr);
+        hid_t dset = H5Dcreate2(group, "counts", H5T_NATIVE_UINT64, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(dset, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, counts.data() + 1);
+        hid_t scalar = H5Screate(H5S_SCALAR);
+        const char* flows[2] = {"underflow", "overflow"};
+        const uint64_t values[2] = {counts.front(), counts.back()};
+        for (unsigned int k = 0; k < 2; ++k) {
+            hid_t attr = H5Acreate2(dset, flows[k], H5T_NATIVE_UINT64, scalar, H5P_DEFAULT, H5P_DEFAULT);
+            H5Awrite(attr, H5T_NATIVE_UINT64, &values[k]);
+            H5Aclose(attr);
+        }
+        H5Sclose(scalar);
+        H5Dclose(dset);
+        H5Sclose(space);
+        H5Gclose(group);
+    }
+};
@@ -0,0 +1,575 @@
+// Hybrid microscopic / Monte Carlo transport of the primary electron through
+// long drift and EL gaps (transport=hybrid in CRAB).
+//
+// Most of the path of the electron is in fields that are uniform to well
+// below a percent, where following every collision with AvalancheMicroscopic
+// costs a lot and tells us nothing a drift line would not. The transport area
+// is cut into z slabs. A slab counts as uniform if the field vector at a grid
+// of points over a disk (at the bottom, middle and top of the slab) stays
+// within a tolerance of its mean. Runs of uniform slabs are drifted with
+// AvalancheMC on the velocity and diffusion of the gas table; the rest (mesh
+// wires, ring edges, electrodes) is tracked microscopically. The electron is
+// handed from one region to the next at the slab boundaries.
+//
+// In the MC regions the excitations are generated statistically. The number
+// of excitations per cm as a function of |E| is calibrated with short
+// microscopic runs of the same gas in a constant field, and every step of
+// the drift line gets a Poisson number of excitations spread uniformly along
+// it. They go to the same collision handle as the microscopic ones, so the
+// EventInfo and summary outputs stay the same. Slabs where the calibration
+// sees gain are left to the microscopic tracking, since the MC drift does not
+// multiply.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Garfield/AvalancheMC.hh"
+#include "Garfield/AvalancheMicroscopic.hh"
+#include "Garfield/Component.hh"
+#include "Garfield/ComponentConstant.hh"
+#include "Garfield/GeometrySimple.hh"
+#include "Garfield/MediumMagboltz.hh"
+#include "Garfield/Random.hh"
+#include "Garfield/Sensor.hh"
+#include "Garfield/SolidBox.hh"
+
+#include "AvalancheRecord.hh"
+#include "RunningStats.hh"
+#include "WorkerPool.hh"
+
+class HybridTransport {
+  public:
+    // Inelastic collision handle of AvalancheMicroscopic
+    using Handle = void (*)(double, double, double, double, int, int, Garfield::Medium*);
+
+    // Start and end point of an electron, as from GetElectronEndpoint
+    struct Endpoint {
+        double x1, y1, z1, t1, e1;
+        double x2, y2, z2, t2, e2;
+        int status;
+    };
+
+    // Transport area: the field map and gas, and the box the electrons are
+    // tracked in (the sensor area of the driver)
+    HybridTransport(Garfield::Component* cmp, Garfield::MediumMagboltz* gas, double xmin, double ymin,
+                    double zmin, double xmax, double ymax, double zmax)
+        : m_cmp(cmp), m_gas(gas), m_xmin(xmin), m_ymin(ymin), m_zmin(std::min(zmin, zmax)),
+          m_xmax(xmax), m_ymax(ymax), m_zmax(std::max(zmin, zmax)) {}
+
+    // Slab thickness [cm], largest relative deviation of the field from its
+    // mean in a uniform slab, radius of the disk checked [cm] and shortest run
+    // of uniform slabs worth switching to MC for [cm]
+    void SetCriterion(double slab, double tolerance, double radius, double minLength) {
+        m_slab = slab;
+        m_tolerance = tolerance;
+        m_radius = radius;
+        m_minLength = minLength;
+    }
+
+    // Calibration runs: number of field values, electrons per value and the
+    // drift length over which the excitations are counted [cm]
+    void SetCalibration(unsigned int nFields, unsigned int nElectrons, double length) {
+        m_nFields = std::max(1u, nFields);
+        m_nElectrons = std::max(1u, nElectrons);
+        m_length = length;
+    }
+
+    // Step of the drift lines in the MC regions [cm]
+    void SetDistanceStep(double step) { m_step = step; }
+
+    // Collision handle that receives the excitations of both kinds of regions
+    void SetUserHandleInelastic(Handle handle) { m_handle = handle; }
+
+    // Find the uniform regions and calibrate the excitation yield in them.
+    // The calibration points are run on nWorkers processes.
+    bool Initialise(unsigned int seed, unsigned int nWorkers) {
+        if (!m_cmp || !m_gas || m_slab <= 0. || m_zmax <= m_zmin) {
+            std::cerr << "HybridTransport::Initialise: Transport area not set." << std::endl;
+            return false;
+        }
+        ScanSlabs();
+
+        // Calibrate over the field range of the uniform slabs
+        double emin = INFINITY, emax = 0.;
+        for (const auto& slab : m_slabs) {
+            if (!slab.uniform) continue;
+            emin = std::min(emin, slab.field);
+            emax = std::max(emax, slab.field);
+        }
+        if (emax > 0.) {
+            Calibrate(seed, nWorkers, (1. - 2. * m_tolerance) * emin, (1. + 2. * m_tolerance) * emax);
+            // The MC drift does not multiply, leave the slabs with gain to AvalancheMicroscopic
+            for (auto& slab : m_slabs) {
+                if (slab.uniform && Interpolate(m_alpha, slab.field) * (slab.zhi - slab.zlo) > kMaxGain) {
+                    slab.uniform = false;
+                }
+            }
+        }
+        m_gas->ResetCollisionCounters();
+
+        MakeRegions();
+        if (m_regions.empty()) {
+            std::cerr << "HybridTransport::Initialise: No regions in the transport area." << std::endl;
+            return false;
+        }
+        m_aval.SetUserHandleInelastic(m_handle);
+        m_drift.SetDistanceSteps(m_step);
+        m_drift.EnableAttachment();
+        PrintRegions();
+        return true;
+    }
+
+    void PrintRegions() const {
+        double lengthMC = 0.;
+        std::cout << "HybridTransport: " << m_regions.size() << " regions\n";
+        for (const auto& region : m_regions) {
+            std::cout << "  z = " << std::setw(9) << region.zlo << " to " << std::setw(9) << region.zhi
+                      << " cm  " << (region.mc ? "MC          " : "microscopic ")
+                      << "|E| = " << region.field << " V/cm";
+            if (region.mc) std::cout << ", " << Interpolate(m_yield, region.field) << " excitations/cm";
+            std::cout << "\n";
+            if (region.mc) lengthMC += region.zhi - region.zlo;
+        }
+        std::cout << "  " << 100. * lengthMC / (m_zmax - m_zmin) << "% of the length in MC regions"
+                  << std::endl;
+    }
+
+    // Transport a primary electron and the electrons of its avalanche through
+    // the regions. Returns the number of excitations generated in the MC
+    // regions (the microscopic ones are in the collision counters of the gas).
+    unsigned int Transport(double x0, double y0, double z0, double t0, double e0,
+                           std::vector<Endpoint>& endpoints, int& ne, int& ni) {
+        endpoints.clear();
+        ne = 0;
+        ni = 0;
+        if (m_regions.empty()) {
+            std::cerr << "HybridTransport::Transport: Not initialised." << std::endl;
+            return 0;
+        }
+        ne = 1;
+        unsigned int nGenerated = 0;
+
+        std::vector<Electron> stack = {{x0, y0, z0, t0, e0, x0, y0, z0, t0, e0, RegionOf(z0)}};
+        unsigned int nHandoffs = 0;
+        while (!stack.empty()) {
+            const Electron el = stack.back();
+            stack.pop_back();
+            Region& region = m_regions[el.region];
+
+            if (region.mc) {
+                m_drift.SetSensor(region.sensor.get());
+                m_drift.DriftElectron(el.x, el.y, el.z, el.t);
+                nGenerated += GenerateExcitations();
+                double x1, y1, z1, t1, x2, y2, z2, t2;
+                int status;
+                m_drift.GetElectronEndpoint(0, x1, y1, z1, t1, x2, y2, z2, t2, status);
+                // Enter the next region with the mean energy of the calibration
+                const double e2 = Interpolate(m_energy, region.field);
+                Finish(el, {el.x0, el.y0, el.z0, el.t0, el.e0, x2, y2, z2, t2, e2, status},
+                       stack, endpoints, nHandoffs);
+                continue;
+            }
+
+            m_aval.SetSensor(region.sensor.get());
+            m_aval.AvalancheElectron(el.x, el.y, el.z, el.t, el.e, 0, 0, 0);
+            int neAval = 0, niAval = 0;
+            m_aval.GetAvalancheSize(neAval, niAval);
+            ne += neAval - 1;
+            ni += niAval;
+            const unsigned int np = m_aval.GetNumberOfElectronEndpoints();
+            for (unsigned int ie = 0; ie < np; ++ie) {
+                Endpoint ep;
+                m_aval.GetElectronEndpoint(ie, ep.x1, ep.y1, ep.z1, ep.t1, ep.e1, ep.x2, ep.y2, ep.z2,
+                                           ep.t2, ep.e2, ep.status);
+                // Keep the start of the electron that was handed over
+                if (ep.x1 == el.x && ep.y1 == el.y && ep.z1 == el.z && ep.t1 == el.t) {
+                    ep.x1 = el.x0;
+                    ep.y1 = el.y0;
+                    ep.z1 = el.z0;
+                    ep.t1 = el.t0;
+                    ep.e1 = el.e0;
+                }
+                Finish(el, ep, stack, endpoints, nHandoffs);
+            }
+        }
+        return nGenerated;
+    }
+
+  private:
+    struct Slab {
+        double zlo, zhi;
+        double field; // Mean |E| [V/cm]
+        bool uniform;
+    };
+
+    struct Region {
+        double zlo, zhi;
+        double field;
+        bool mc;
+        std::unique_ptr<Garfield::Sensor> sensor; // Restricted to the region
+    };
+
+    // Electron waiting to be transported in a region, and where it started
+    struct Electron {
+        double x, y, z, t, e;
+        double x0, y0, z0, t0, e0;
+        unsigned int region;
+    };
+
+    // Status of an electron that left the area of the sensor
+    static constexpr int kLeftDriftArea = -1;
+    // Tolerance [cm] for an endpoint to be on a region boundary
+    static constexpr double kEps = 1.e-4;
+    // Largest number of ionisations per slab for MC transport
+    static constexpr double kMaxGain = 1.e-3;
+
+    Garfield::Component* m_cmp;
+    Garfield::MediumMagboltz* m_gas;
+    double m_xmin, m_ymin, m_zmin, m_xmax, m_ymax, m_zmax;
+
+    double m_slab = 0.01;
+    double m_tolerance = 0.005;
+    double m_radius = 0.5;
+    double m_minLength = 0.1;
+    unsigned int m_nFields = 12;
+    unsigned int m_nElectrons = 20;
+    double m_length = 0.2;
+    double m_step = 0.005;
+    Handle m_handle = nullptr;
+
+    std::vector<Slab> m_slabs;
+    std::vector<Region> m_regions;
+
+    // Calibration: excitations and ionisations per cm and mean electron
+    // energy [eV] as a function of |E|
+    std::vector<double> m_fields, m_yield, m_alpha, m_energy;
+
+    Garfield::AvalancheMicroscopic m_aval;
+    Garfield::AvalancheMC m_drift;
+
+    // Excitations counted by the calibration runs between zlo and zhi
+    static inline thread_local unsigned int sm_nExc = 0;
+    static inline thread_local double sm_zlo = 0., sm_zhi = 0.;
+
+    static void CountExcitation(double /*x*/, double /*y*/, double z, double /*t*/,
+                                int type, int /*level*/, Garfield::Medium* /*m*/) {
+        if (type == 4 && z >= sm_zlo && z <= sm_zhi) ++sm_nExc;
+    }
+
+    void ScanSlabs() {
+        m_slabs.clear();
+        const double xc = 0.5 * (m_xmin + m_xmax);
+        const double yc = 0.5 * (m_ymin + m_ymax);
+        const unsigned int nSlabs = static_cast<unsigned int>(std::ceil((m_zmax - m_zmin) / m_slab - 1.e-9));
+        constexpr int nGrid = 4; // Points per radius
+        for (unsigned int s = 0; s < nSlabs; ++s) {
+            Slab slab;
+            slab.zlo = m_zmin + s * m_slab;
+            slab.zhi = std::min(m_zmax, slab.zlo + m_slab);
+            std::vector<double> ex, ey, ez;
+            bool ok = true;
+            for (const double z : {slab.zlo, 0.5 * (slab.zlo + slab.zhi), slab.zhi}) {
+                for (int ix = -nGrid; ix <= nGrid && ok; ++ix) {
+                    for (int iy = -nGrid; iy <= nGrid && ok; ++iy) {
+                        if (ix * ix + iy * iy > nGrid * nGrid) continue;
+                        const double x = xc + m_radius * ix / nGrid;
+                        const double y = yc + m_radius * iy / nGrid;
+                        double fx, fy, fz;
+                        Garfield::Medium* medium = nullptr;
+                        int status = 0;
+                        m_cmp->ElectricField(x, y, z, fx, fy, fz, medium, status);
+                        // Outside the gas (wires, electrodes) is not uniform
+                        if (status != 0 || !medium || !medium->IsDriftable()) ok = false;
+                        ex.push_back(fx);
+                        ey.push_back(fy);
+                        ez.push_back(fz);
+                    }
+                }
+            }
+            const double n = ex.size();
+            double mx = 0., my = 0., mz = 0.;
+            for (size_t k = 0; k < ex.size(); ++k) {
+                mx += ex[k] / n;
+                my += ey[k] / n;
+                mz += ez[k] / n;
+            }
+            slab.field = std::sqrt(mx * mx + my * my + mz * mz);
+            double deviation = 0.;
+            for (size_t k = 0; k < ex.size(); ++k) {
+                const double dx = ex[k] - mx, dy = ey[k] - my, dz = ez[k] - mz;
+                deviation = std::max(deviation, std::sqrt(dx * dx + dy * dy + dz * dz));
+            }
+            slab.uniform = ok && slab.field > 0. && deviation <= m_tolerance * slab.field;
+            m_slabs.push_back(slab);
+        }
+    }
+
+    // Microscopic runs in a constant field at nFields values between emin and emax
+    void Calibrate(unsigned int seed, unsigned int nWorkers, double emin, double emax) {
+        m_fields.clear();
+        for (unsigned int k = 0; k < m_nFields; ++k) {
+            const double f = m_nFields > 1 ? double(k) / (m_nFields - 1) : 0.5;
+            m_fields.push_back(emin * std::pow(emax / emin, f));
+        }
+        m_yield.assign(m_nFields, 0.);
+        m_alpha.assign(m_nFields, 0.);
+        m_energy.assign(m_nFields, 1.);
+
+        // Let the electron relax before counting
+        const double skip = 0.25 * m_length;
+        const double total = skip + m_length;
+
+        auto task = [&](unsigned int k, std::string& payload) {
+            Garfield::randomEngine.Seed(WorkerPool::ItemSeed(seed, k));
+            Garfield::SolidBox box(0., 0., -0.5 * total, 10., 10., 0.5 * total);
+            Garfield::GeometrySimple geo;
+            geo.AddSolid(&box, m_gas);
+            Garfield::ComponentConstant cmp;
+            cmp.SetGeometry(&geo);
+            cmp.SetMedium(m_gas);
+            // Electrons drift against the field, towards -z
+            cmp.SetElectricField(0., 0., m_fields[k]);
+            Garfield::Sensor sensor;
+            sensor.AddComponent(&cmp);
+            sensor.SetArea(-10., -10., -total, 10., 10., 0.);
+            Garfield::AvalancheMicroscopic aval;
+            aval.SetSensor(&sensor);
+            aval.SetUserHandleInelastic(CountExcitation);
+
+            sm_nExc = 0;
+            sm_zlo = -total;
+            sm_zhi = -skip;
+            unsigned int nIon = 0;
+            RunningStats energy;
+            for (unsigned int i = 0; i < m_nElectrons; ++i) {
+                aval.AvalancheElectron(0., 0., -kEps, 0., 1., 0., 0., 0.);
+                int ne = 0, ni = 0;
+                aval.GetAvalancheSize(ne, ni);
+                nIon += ne - 1;
+                const unsigned int np = aval.GetNumberOfElectronEndpoints();
+                for (unsigned int ie = 0; ie < np; ++ie) {
+                    double x1, y1, z1, t1, e1, x2, y2, z2, t2, e2;
+                    int status;
+                    aval.GetElectronEndpoint(ie, x1, y1, z1, t1, e1, x2, y2, z2, t2, e2, status);
+                    if (z2 < -total + kEps) energy.Add(e2);
+                }
+            }
+            const double yield = double(sm_nExc) / (m_nElectrons * m_length);
+            const double alpha = double(nIon) / (m_nElectrons * total);
+            WorkerPool::Pack(payload, yield);
+            WorkerPool::Pack(payload, alpha);
+            WorkerPool::Pack(payload, energy.n > 0 ? energy.mean : 1.);
+        };
+        auto sink = [&](unsigned int k, const std::string& payload) {
+            size_t pos = 0;
+            WorkerPool::Unpack(payload, pos, m_yield[k]);
+            WorkerPool::Unpack(payload, pos, m_alpha[k]);
+            WorkerPool::Unpack(payload, pos, m_energy[k]);
+        };
+        if (!WorkerPool::Run(m_nFields, nWorkers, task, sink)) {
+            std::cerr << "HybridTransport::Calibrate: Not all calibration runs succeeded." << std::endl;
+        }
+
+        std::cout << "HybridTransport: excitation yield from " << m_nElectrons << " electrons over "
+                  << m_length << " cm\n"
+                  << "  |E| [V/cm]   excitations/cm   ionisations/cm   energy [eV]\n";
+        for (unsigned int k = 0; k < m_nFields; ++k) {
+            std::cout << "  " << std::setw(10) << m_fields[k] << "   " << std::setw(14) << m_yield[k]
+                      << "   " << std::setw(14) << m_alpha[k] << "   " << std::setw(11) << m_energy[k]
+                      << "\n";
+        }
+        std::cout << std::flush;
+    }
+
+    // Join neighbouring slabs of the same kind; runs of uniform slabs that are
+    // too short to be worth the switch are tracked microscopically
+    void MakeRegions() {
+        auto join = [this](bool allowShort) {
+            m_regions.clear();
+            for (const auto& slab : m_slabs) {
+                if (!m_regions.empty() && m_regions.back().mc == slab.uniform) {
+                    Region& last = m_regions.back();
+                    const double l1 = last.zhi - last.zlo, l2 = slab.zhi - slab.zlo;
+                    last.field = (last.field * l1 + slab.field * l2) / (l1 + l2);
+                    last.zhi = slab.zhi;
+                    continue;
+                }
+                m_regions.push_back({slab.zlo, slab.zhi, slab.field, slab.uniform, nullptr});
+            }
+            if (allowShort) return;
+            for (const auto& region : m_regions) {
+                if (!region.mc || region.zhi - region.zlo >= m_minLength - kEps) continue;
+                for (auto& slab : m_slabs) {
+                    if (slab.zlo >= region.zlo - kEps && slab.zhi <= region.zhi + kEps) slab.uniform = false;
+                }
+            }
+        };
+        join(false);
+        join(true);
+
+        for (auto& region : m_regions) {
+            region.sensor.reset(new Garfield::Sensor());
+            region.sensor->AddComponent(m_cmp);
+            region.sensor->SetArea(m_xmin, m_ymin, region.zlo, m_xmax, m_ymax, region.zhi);
+        }
+    }
+
+    unsigned int RegionOf(double z) const {
+        if (m_regions.empty()) return 0;
+        for (unsigned int r = 0; r < m_regions.size(); ++r) {
+            if (z <= m_regions[r].zhi) return r;
+        }
+        return m_regions.size() - 1;
+    }
+
+    // Hand an electron that left its region through a slab boundary on to the
+    // next one, or keep its endpoint
+    void Finish(const Electron& el, const Endpoint& ep, std::vector<Electron>& stack,
+                std::vector<Endpoint>& endpoints, unsigned int& nHandoffs) {
+        const bool inside = ep.x2 > m_xmin + kEps && ep.x2 < m_xmax - kEps &&
+                            ep.y2 > m_ymin + kEps && ep.y2 < m_ymax - kEps;
+        int next = -1;
+        if (ep.status == kLeftDriftArea && inside) {
+            if (ep.z2 <= m_regions[el.region].zlo + kEps && el.region > 0) next = el.region - 1;
+            if (ep.z2 >= m_regions[el.region].zhi - kEps && el.region + 1 < m_regions.size()) next = el.region + 1;
+        }
+        // Guard against an electron going back and forth across a boundary forever
+        if (next < 0 || ++nHandoffs > 100000) {
+            endpoints.push_back(ep);
+            return;
+        }
+        const Region& region = m_regions[next];
+        const double z = std::min(std::max(ep.z2, region.zlo), region.zhi);
+        stack.push_back({ep.x2, ep.y2, z, ep.t2, ep.e2, ep.x1, ep.y1, ep.z1, ep.t1, ep.e1,
+                         static_cast<unsigned int>(next)});
+    }
+
+    // Poisson number of excitations on every step of the last drift line
+    unsigned int GenerateExcitations() {
+        const unsigned int np = m_drift.GetNumberOfDriftLinePoints();
+        if (np < 2 || !m_handle) return 0;
+        unsigned int nGenerated = 0;
+        double xa, ya, za, ta;
+        m_drift.GetDriftLinePoint(0, xa, ya, za, ta);
+        for (unsigned int i = 1; i < np; ++i) {
+            double xb, yb, zb, tb;
+            m_drift.GetDriftLinePoint(i, xb, yb, zb, tb);
+            const double dx = xb - xa, dy = yb - ya, dz = zb - za;
+            const double length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (length > 0.) {
+                double ex, ey, ez;
+                Garfield::Medium* medium = nullptr;
+                int status = 0;
+                m_cmp->ElectricField(0.5 * (xa + xb), 0.5 * (ya + yb), 0.5 * (za + zb), ex, ey, ez, medium, status);
+                const double field = std::sqrt(ex * ex + ey * ey + ez * ez);
+                const int n = Garfield::RndmPoisson(Interpolate(m_yield, field) * length);
+                for (int k = 0; k < n; ++k) {
+                    const double f = Garfield::RndmUniform();
+                    m_handle(xa + f * dx, ya + f * dy, za + f * dz, ta + f * (tb - ta), 4, 0, m_gas);
+                }
+                nGenerated += n;
+            }
+            xa = xb;
+            ya = yb;
+            za = zb;
+            ta = tb;
+        }
+        return nGenerated;
+    }
+
+    // Linear interpolation in the calibration table, constant outside it
+    double Interpolate(const std::vector<double>& values, double field) const {
+        if (m_fields.empty()) return 0.;
+        if (field <= m_fields.front()) return values.front();
+        if (field >= m_fields.back()) return values.back();
+        const size_t k = std::upper_bound(m_fields.begin(), m_fields.end(), field) - m_fields.begin();
+        const double f = (field - m_fields[k - 1]) / (m_fields[k] - m_fields[k - 1]);
+        return values[k - 1] + f * (values[k] - values[k - 1]);
+    }
+};
+
+// Comparison of the hybrid transport with pure microscopic tracking of the
+// same primary electrons (transport=validate)
+class TransportValidation {
+  public:
+    // What is compared for one avalanche
+    struct Sample {
+        double excitations = 0.; // Collision counters plus generated
+        double photons = 0.;     // Excitations in the output
+        double tMean = 0., tStd = 0., zMean = 0., rStd = 0.;
+        double seconds = 0.;     // Wall-clock time of the transport
+    };
+
+    static Sample MakeSample(const ExcitationBuffer& exc, double excitations, double seconds) {
+        Sample s;
+        s.excitations = excitations;
+        s.photons = exc.size();
+        s.seconds = seconds;
+        RunningStats t, z, x, y;
+        for (size_t i = 0; i < exc.size(); ++i) {
+            t.Add(exc.t[i]);
+            z.Add(exc.z[i]);
+            x.Add(exc.x[i]);
+            y.Add(exc.y[i]);
+        }
+        s.tMean = t.mean;
+        s.tStd = t.StdDev();
+        s.zMean = z.mean;
+        s.rStd = std::sqrt(x.Variance() + y.Variance());
+        return s;
+    }
+
+    void Add(const Sample& micro, const Sample& hybrid) {
+        const double m[kNumberOfQuantities] = {micro.excitations, micro.photons, micro.tMean,
+                                               micro.tStd, micro.zMean, micro.rStd};
+        const double h[kNumberOfQuantities] = {hybrid.excitations, hybrid.photons, hybrid.tMean,
+                                               hybrid.tStd, hybrid.zMean, hybrid.rStd};
+        for (unsigned int k = 0; k < kNumberOfQuantities; ++k) {
+            m_micro[k].Add(m[k]);
+            m_hybrid[k].Add(h[k]);
+        }
+        m_microTime.Add(micro.seconds);
+        m_hybridTime.Add(hybrid.seconds);
+    }
+
+    // Means of both transports, their ratio and the difference in units of
+    // its error, and the speedup in wall-clock time per avalanche
+    void Print(std::ostream& out) const {
+        static const char* names[kNumberOfQuantities] = {"excitations", "photons", "t mean [ns]",
+                                                         "t std [ns]", "z mean [cm]", "r std [cm]"};
+        out << "Transport validation over " << m_microTime.n << " avalanches\n"
+            << std::setw(14) << "quantity" << std::setw(26) << "microscopic" << std::setw(26) << "hybrid"
+            << std::setw(10) << "ratio" << std::setw(10) << "pull" << "\n";
+        for (unsigned int k = 0; k < kNumberOfQuantities; ++k) {
+            const auto& m = m_micro[k];
+            const auto& h = m_hybrid[k];
+            const double err = std::sqrt(m.StdErr() * m.StdErr() + h.StdErr() * h.StdErr());
+            out << std::setw(14) << names[k] << std::setw(14) << m.mean << " +- " << std::setw(8) << m.StdErr()
+                << std::setw(14) << h.mean << " +- " << std::setw(8) << h.StdErr() << std::setw(10)
+                << (m.mean != 0. ? h.mean / m.mean : 0.) << std::setw(10)
+                << (err > 0. ? (h.mean - m.mean) / err : 0.) << "\n";
+        }
+        out << "Time per avalanche: microscopic " << m_microTime.mean << " s, hybrid " << m_hybridTime.mean
+            << " s, speedup " << (m_hybridTime.mean > 0. ? m_microTime.mean / m_hybridTime.mean : 0.)
+            << std::endl;
+    }
+
+    bool Write(const std::string& filename) const {
+        std::ofstream out(filename);
+        if (!out) return false;
+        Print(out);
+        return true;
+    }
+
+  private:
+    static constexpr unsigned int kNumberOfQuantities = 6;
+    RunningStats m_micro[kNumberOfQuantities], m_hybrid[kNumberOfQuantities];
+    RunningStats m_microTime, m_hybridTime;
+};
@@ -0,0 +1,31 @@
+// Switch for the per-avalanche printout of the drivers, which otherwise
+// dominates the log files and skews the timing of production runs. It is
+// turned off at run time with verbose=0, or compiled out altogether with
+// cmake -DQUIET=ON (which defines EL_QUIET).
+//
+//   VLOG(1) << "Avalanche " << i << " of " << npe << ".\n";
+#pragma once
+
+#include <iostream>
+
+namespace Log {
+
+// 0: set-up, warnings and summaries only, 1: a few lines per avalanche
+inline int& Verbosity() {
+    static int level = 1;
+    return level;
+}
+
+inline bool Enabled(int level) {
+#ifdef EL_QUIET
+    return level <= 0;
+#else
+    return level <= Verbosity();
+#endif
+}
+
+} // namespace Log
+
+// std::cout if the printout of this level is enabled. The arguments are not
+// evaluated otherwise.
+#define VLOG(level) if (!Log::Enabled(level)) {} else std::cout
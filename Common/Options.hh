@@ -0,0 +1,26 @@
+// Optional key=value arguments that can follow the positional arguments of the
+// drivers, e.g.
+//   ./build/Mesh 0 20 20 1 0 Rotated <gridfile> <datafile> 13.5 threads=8
+#pragma once
+
+#include <string>
+
+// Return the value given for "key", or def if it was not given
+inline std::string GetOption(int argc, char* argv[], const std::string& key, const std::string& def) {
+    const std::string prefix = key + "=";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+inline int GetOption(int argc, char* argv[], const std::string& key, int def) {
+    const std::string value = GetOption(argc, argv, key, std::string());
+    return value.empty() ? def : std::stoi(value);
+}
+
+inline double GetOption(int argc, char* argv[], const std::string& key, double def) {
+    const std::string value = GetOption(argc, argv, key, std::string());
+    return value.empty() ? def : std::stod(value);
+}
@@ -0,0 +1,461 @@
+// Minimal reader/writer for the HDF5 files that pandas (through PyTables)
+// reads and writes, so the C++ programs can exchange tables with the python
+// scripts and notebooks without going through python.
+//
+//   TableReader   reads named fields of a compound table (e.g. the NEXUS
+//                 MC/hits table), a range of rows at a time.
+//   ReadTable     reads float columns of a frame written with
+//                 to_hdf(format="table"), decoding categorical columns
+//                 (e.g. the q, r bins of the unit-cell maps).
+//   ReadFixed     the same for a frame in the default "fixed" format.
+//   ReadFrame     either of the two, depending on the format of the frame.
+//   WriteFrame    writes float columns as a frame in the default "fixed"
+//                 format of to_hdf, readable with pd.read_hdf.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+namespace PandasH5 {
+
+// Column names stored by pandas as a protocol 0 pickled list,
+// e.g. "(lp0\nVexcitation\np1\naVx\np2\naVy\np3\na."
+inline std::vector<std::string> ParseNames(const std::string& pickle) {
+    std::vector<std::string> names;
+    size_t pos = 0;
+    while (pos < pickle.size()) {
+        size_t end = pickle.find('\n', pos);
+        if (end == std::string::npos) end = pickle.size();
+        std::string line = pickle.substr(pos, end - pos);
+        if (line.compare(0, 2, "aV") == 0) line.erase(0, 1);
+        if (!line.empty() && line[0] == 'V') names.push_back(line.substr(1));
+        pos = end + 1;
+    }
+    return names;
+}
+
+// Value of a string attribute, empty if it does not exist
+inline std::string GetStringAttribute(hid_t obj, const std::string& name) {
+    if (H5Aexists(obj, name.c_str()) <= 0) return "";
+    hid_t attr = H5Aopen(obj, name.c_str(), H5P_DEFAULT);
+    hid_t type = H5Aget_type(attr);
+    std::string value;
+    if (H5Tget_class(type) == H5T_STRING && !H5Tis_variable_str(type)) {
+        std::vector<char> buf(H5Tget_size(type) + 1, '\0');
+        // Keep the character set of the file (PyTables writes UTF-8)
+        hid_t mtype = H5Tcopy(type);
+        H5Tset_size(mtype, buf.size());
+        H5Tset_strpad(mtype, H5T_STR_NULLTERM);
+        H5Aread(attr, mtype, buf.data());
+        H5Tclose(mtype);
+        value = buf.data();
+    }
+    H5Tclose(type);
+    H5Aclose(attr);
+    return value;
+}
+
+// Reads fields of a 1D compound dataset by name. Only the requested field is
+// read from the file and converted to the requested type by HDF5.
+class TableReader {
+  public:
+    TableReader(const std::string& filename, const std::string& dataset) {
+        H5E_BEGIN_TRY {
+            m_file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+            if (m_file >= 0) m_dset = H5Dopen2(m_file, dataset.c_str(), H5P_DEFAULT);
+        } H5E_END_TRY;
+        if (m_dset < 0) {
+            std::cerr << "PandasH5::TableReader: Could not open " << dataset << " in " << filename << std::endl;
+            return;
+        }
+        m_type = H5Dget_type(m_dset);
+        hid_t space = H5Dget_space(m_dset);
+        H5Sget_simple_extent_dims(space, &m_rows, nullptr);
+        H5Sclose(space);
+    }
+
+    ~TableReader() {
+        if (m_type >= 0) H5Tclose(m_type);
+        if (m_dset >= 0) H5Dclose(m_dset);
+        if (m_file >= 0) H5Fclose(m_file);
+    }
+
+    TableReader(const TableReader&) = delete;
+    TableReader& operator=(const TableReader&) = delete;
+
+    bool IsOpen() const { return m_dset >= 0; }
+    hid_t Dataset() const { return m_dset; }
+    uint64_t NumberOfRows() const { return m_rows; }
+
+    bool HasField(const std::string& field) const {
+        return m_type >= 0 && H5Tget_member_index(m_type, field.c_str()) >= 0;
+    }
+
+    // Number of values per row of a field (> 1 for array members)
+    size_t Width(const std::string& field) const {
+        std::vector<hsize_t> dims;
+        if (!ArrayDims(field, dims)) return 0;
+        size_t width = 1;
+        for (const hsize_t d : dims) width *= d;
+        return width;
+    }
+
+    // Rows [start, start + n) of a numeric field, Width() values per row
+    bool Read(const std::string& field, uint64_t start, uint64_t n, std::vector<double>& values) const {
+        std::vector<hsize_t> dims;
+        if (!ArrayDims(field, dims)) {
+            std::cerr << "PandasH5::TableReader: No field " << field << std::endl;
+            return false;
+        }
+        // Array members (pandas value blocks, even of width 1) are read as
+        // arrays of the same shape
+        size_t width = 1;
+        for (const hsize_t d : dims) width *= d;
+        values.resize(n * width);
+        hid_t ftype = H5T_NATIVE_DOUBLE;
+        if (!dims.empty()) ftype = H5Tarray_create2(H5T_NATIVE_DOUBLE, dims.size(), dims.data());
+        const bool ok = ReadMember(field, ftype, width * sizeof(double), start, n, values.data());
+        if (!dims.empty()) H5Tclose(ftype);
+        return ok;
+    }
+
+    // Rows [start, start + n) of a fixed length string field
+    bool Read(const std::string& field, uint64_t start, uint64_t n, std::vector<std::string>& values) const {
+        const int index = H5Tget_member_index(m_type, field.c_str());
+        if (index < 0) {
+            std::cerr << "PandasH5::TableReader: No field " << field << std::endl;
+            return false;
+        }
+        hid_t ftype = H5Tget_member_type(m_type, index);
+        const size_t size = H5Tget_size(ftype);
+        H5Tclose(ftype);
+        hid_t stype = H5Tcopy(H5T_C_S1);
+        H5Tset_size(stype, size);
+        H5Tset_strpad(stype, H5T_STR_NULLPAD);
+        std::vector<char> buf(n * size);
+        const bool ok = ReadMember(field, stype, size, start, n, buf.data());
+        H5Tclose(stype);
+        values.resize(n);
+        for (uint64_t i = 0; i < n; ++i) {
+            const char* s = buf.data() + i * size;
+            values[i].assign(s, strnlen(s, size));
+        }
+        return ok;
+    }
+
+  private:
+    hid_t m_file = -1;
+    hid_t m_dset = -1;
+    hid_t m_type = -1;
+    hsize_t m_rows = 0;
+
+    // Dimensions of an array member, empty for scalar members
+    bool ArrayDims(const std::string& field, std::vector<hsize_t>& dims) const {
+        dims.clear();
+        const int index = m_type >= 0 ? H5Tget_member_index(m_type, field.c_str()) : -1;
+        if (index < 0) return false;
+        hid_t ftype = H5Tget_member_type(m_type, index);
+        if (H5Tget_class(ftype) == H5T_ARRAY) {
+            dims.resize(H5Tget_array_ndims(ftype));
+            H5Tget_array_dims2(ftype, dims.data());
+        }
+        H5Tclose(ftype);
+        return true;
+    }
+
+    bool ReadMember(const std::string& field, hid_t ftype, size_t size, uint64_t start, uint64_t n, void* buf) const {
+        if (n == 0) return true;
+        hid_t mtype = H5Tcreate(H5T_COMPOUND, size);
+        H5Tinsert(mtype, field.c_str(), 0, ftype);
+        hid_t fspace = H5Dget_space(m_dset);
+        const hsize_t offset[1] = {start};
+        const hsize_t count[1] = {n};
+        H5Sselect_hyperslab(fspace, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        hid_t mspace = H5Screate_simple(1, count, nullptr);
+        const herr_t status = H5Dread(m_dset, mtype, mspace, fspace, H5P_DEFAULT, buf);
+        H5Sclose(mspace);
+        H5Sclose(fspace);
+        H5Tclose(mtype);
+        return status >= 0;
+    }
+};
+
+// Read the given columns of a frame stored with to_hdf(key, format="table").
+// Columns are either data columns (a field of their own) or part of a
+// values_block_N field; categorical columns are replaced by their values.
+inline bool ReadTable(const std::string& filename, const std::string& key,
+                      const std::vector<std::string>& columns,
+                      std::vector<std::vector<double>>& values) {
+    TableReader table(filename, key + "/table");
+    if (!table.IsOpen()) return false;
+    const uint64_t nRows = table.NumberOfRows();
+
+    values.assign(columns.size(), std::vector<double>());
+    for (size_t c = 0; c < columns.size(); ++c) {
+        const std::string& column = columns[c];
+        std::string field = column;
+        std::string meta;
+        size_t position = 0;
+        if (!table.HasField(field)) {
+            field.clear();
+            for (int block = 0; table.HasField("values_block_" + std::to_string(block)); ++block) {
+                const std::string name = "values_block_" + std::to_string(block);
+                const auto names = ParseNames(GetStringAttribute(table.Dataset(), name + "_kind"));
+                for (size_t k = 0; k < names.size(); ++k) {
+                    if (names[k] != column) continue;
+                    field = name;
+                    position = k;
+                    meta = GetStringAttribute(table.Dataset(), name + "_meta");
+                }
+            }
+        } else {
+            meta = GetStringAttribute(table.Dataset(), column + "_meta");
+        }
+        if (field.empty()) {
+            std::cerr << "PandasH5::ReadTable: No column " << column << " in " << filename << std::endl;
+            return false;
+        }
+
+        std::vector<double> raw;
+        if (!table.Read(field, 0, nRows, raw)) return false;
+        const size_t width = table.Width(field);
+        values[c].resize(nRows);
+        for (uint64_t i = 0; i < nRows; ++i) values[c][i] = raw[i * width + position];
+
+        if (meta != "category") continue;
+        // Categories are stored as a series table under meta/<field>/meta
+        TableReader categories(filename, key + "/meta/" + field + "/meta/table");
+        std::vector<double> cat;
+        if (!categories.IsOpen() || !categories.Read("values", 0, categories.NumberOfRows(), cat)) return false;
+        for (auto& v : values[c]) {
+            const long code = static_cast<long>(v);
+            v = (code >= 0 && code < static_cast<long>(cat.size())) ? cat[code] : std::nan("");
+        }
+    }
+    return true;
+}
+
+// Read the given columns of a frame stored with to_hdf(key) in the default
+// fixed format: the columns of each block are stored in a 2D array.
+inline bool ReadFixed(const std::string& filename, const std::string& key,
+                      const std::vector<std::string>& columns,
+                      std::vector<std::vector<double>>& values) {
+    hid_t file = -1, group = -1;
+    H5E_BEGIN_TRY {
+        file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file >= 0) group = H5Gopen2(file, key.c_str(), H5P_DEFAULT);
+    } H5E_END_TRY;
+    if (group < 0) {
+        std::cerr << "PandasH5::ReadFixed: Could not open " << key << " in " << filename << std::endl;
+        if (file >= 0) H5Fclose(file);
+        return false;
+    }
+
+    values.assign(columns.size(), std::vector<double>());
+    std::vector<bool> found(columns.size(), false);
+    int64_t nBlocks = 0;
+    if (H5Aexists(group, "nblocks") > 0) {
+        hid_t attr = H5Aopen(group, "nblocks", H5P_DEFAULT);
+        H5Aread(attr, H5T_NATIVE_INT64, &nBlocks);
+        H5Aclose(attr);
+    }
+    for (int64_t block = 0; block < nBlocks; ++block) {
+        const std::string name = "block" + std::to_string(block);
+        hid_t items = H5Dopen2(group, (name + "_items").c_str(), H5P_DEFAULT);
+        hid_t dset = H5Dopen2(group, (name + "_values").c_str(), H5P_DEFAULT);
+        if (items < 0 || dset < 0) break;
+
+        // Column names of the block
+        hid_t itype = H5Dget_type(items);
+        const size_t size = H5Tget_size(itype);
+        hid_t ispace = H5Dget_space(items);
+        hsize_t nItems = 0;
+        H5Sget_simple_extent_dims(ispace, &nItems, nullptr);
+        std::vector<char> buf(nItems * size);
+        H5Dread(items, itype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf.data());
+        H5Sclose(ispace);
+        H5Tclose(itype);
+
+        hid_t space = H5Dget_space(dset);
+        hsize_t dims[2] = {0, 0};
+        H5Sget_simple_extent_dims(space, dims, nullptr);
+        H5Sclose(space);
+        std::vector<double> block2d(dims[0] * dims[1]);
+        bool ok = dims[1] == nItems;
+        if (ok && !block2d.empty()) {
+            ok = H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, block2d.data()) >= 0;
+        }
+        for (hsize_t k = 0; ok && k < nItems; ++k) {
+            const std::string item(buf.data() + k * size, strnlen(buf.data() + k * size, size));
+            for (size_t c = 0; c < columns.size(); ++c) {
+                if (columns[c] != item) continue;
+                values[c].resize(dims[0]);
+                for (hsize_t i = 0; i < dims[0]; ++i) values[c][i] = block2d[i * dims[1] + k];
+                found[c] = true;
+            }
+        }
+        H5Dclose(dset);
+        H5Dclose(items);
+    }
+    H5Gclose(group);
+    H5Fclose(file);
+
+    for (size_t c = 0; c < columns.size(); ++c) {
+        if (found[c]) continue;
+        std::cerr << "PandasH5::ReadFixed: No column " << columns[c] << " in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Read the given columns of a frame in either the table or the fixed format
+inline bool ReadFrame(const std::string& filename, const std::string& key,
+                      const std::vector<std::string>& columns,
+                      std::vector<std::vector<double>>& values) {
+    std::string type;
+    H5E_BEGIN_TRY {
+        hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        hid_t group = file >= 0 ? H5Gopen2(file, key.c_str(), H5P_DEFAULT) : -1;
+        if (group >= 0) {
+            type = GetStringAttribute(group, "pandas_type");
+            H5Gclose(group);
+        }
+        if (file >= 0) H5Fclose(file);
+    } H5E_END_TRY;
+    if (type == "frame") return ReadFixed(filename, key, columns, values);
+    return ReadTable(filename, key, columns, values);
+}
+
+namespace detail {
+
+// Strings are stored as UTF-8, so that PyTables returns str rather than bytes.
+// Pickled python objects are ASCII strings, which PyTables unpickles.
+inline void SetAttribute(hid_t obj, const std::string& name, const std::string& value,
+                         bool pickled = false) {
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, value.empty() ? 1 : value.size());
+    if (!pickled) H5Tset_cset(type, H5T_CSET_UTF8);
+    // An empty string is stored with a null dataspace, as PyTables does
+    hid_t space = H5Screate(value.empty() ? H5S_NULL : H5S_SCALAR);
+    hid_t attr = H5Acreate2(obj, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+    if (!value.empty()) H5Awrite(attr, type, value.data());
+    H5Aclose(attr);
+    H5Sclose(space);
+    H5Tclose(type);
+}
+
+inline void SetAttribute(hid_t obj, const std::string& name, int64_t value) {
+    hid_t space = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(obj, name.c_str(), H5T_NATIVE_INT64, space, H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(attr, H5T_NATIVE_INT64, &value);
+    H5Aclose(attr);
+    H5Sclose(space);
+}
+
+// PyTables Array node
+inline void WriteArray(hid_t group, const std::string& name, hid_t type, int rank,
+                       const hsize_t* dims, const void* data, const std::string& kind) {
+    hid_t space = H5Screate_simple(rank, dims, nullptr);
+    hid_t dset = H5Dcreate2(group, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5Dwrite(dset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    SetAttribute(dset, "CLASS", std::string("ARRAY"));
+    SetAttribute(dset, "VERSION", std::string("2.4"));
+    SetAttribute(dset, "TITLE", std::string());
+    SetAttribute(dset, "FLAVOR", std::string("numpy"));
+    hid_t bspace = H5Screate(H5S_SCALAR);
+    hid_t attr = H5Acreate2(dset, "transposed", H5T_NATIVE_B8, bspace, H5P_DEFAULT, H5P_DEFAULT);
+    const uint8_t transposed = 1;
+    H5Awrite(attr, H5T_NATIVE_B8, &transposed);
+    H5Aclose(attr);
+    H5Sclose(bspace);
+    if (!kind.empty()) {
+        SetAttribute(dset, "kind", kind);
+        // Pickled None, the index has no name
+        SetAttribute(dset, "name", std::string("N."), true);
+    }
+    H5Dclose(dset);
+    H5Sclose(space);
+}
+
+inline void WriteNames(hid_t group, const std::string& name, const std::vector<std::string>& names) {
+    size_t size = 1;
+    for (const auto& n : names) size = std::max(size, n.size());
+    std::vector<char> buf(names.size() * size, '\0');
+    for (size_t i = 0; i < names.size(); ++i) std::memcpy(buf.data() + i * size, names[i].data(), names[i].size());
+    hid_t type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type, size);
+    const hsize_t dims[1] = {names.size()};
+    WriteArray(group, name, type, 1, dims, buf.data(), "string");
+    H5Tclose(type);
+}
+
+} // namespace detail
+
+// Write float columns (all of the same length) as the frame "key" of a new
+// file, with a 0..n-1 index, like DataFrame.to_hdf(filename, key, mode="w").
+inline bool WriteFrame(const std::string& filename, const std::string& key,
+                       const std::vector<std::string>& names,
+                       const std::vector<std::vector<double>>& columns) {
+    const size_t nRows = columns.empty() ? 0 : columns[0].size();
+    for (const auto& column : columns) {
+        if (column.size() != nRows) {
+            std::cerr << "PandasH5::WriteFrame: Columns of different length." << std::endl;
+            return false;
+        }
+    }
+
+    hid_t file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file < 0) {
+        std::cerr << "PandasH5::WriteFrame: Could not create " << filename << std::endl;
+        return false;
+    }
+    hid_t root = H5Gopen2(file, "/", H5P_DEFAULT);
+    detail::SetAttribute(root, "CLASS", std::string("GROUP"));
+    detail::SetAttribute(root, "PYTABLES_FORMAT_VERSION", std::string("2.1"));
+    detail::SetAttribute(root, "TITLE", std::string());
+    detail::SetAttribute(root, "VERSION", std::string("1.0"));
+    H5Gclose(root);
+
+    hid_t group = H5Gcreate2(file, key.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    detail::SetAttribute(group, "CLASS", std::string("GROUP"));
+    detail::SetAttribute(group, "TITLE", std::string());
+    detail::SetAttribute(group, "VERSION", std::string("1.0"));
+    detail::SetAttribute(group, "pandas_type", std::string("frame"));
+    detail::SetAttribute(group, "pandas_version", std::string("0.15.2"));
+    detail::SetAttribute(group, "encoding", std::string("UTF-8"));
+    detail::SetAttribute(group, "errors", std::string("strict"));
+    detail::SetAttribute(group, "ndim", int64_t(2));
+    detail::SetAttribute(group, "nblocks", int64_t(1));
+    detail::SetAttribute(group, "axis0_variety", std::string("regular"));
+    detail::SetAttribute(group, "axis1_variety", std::string("regular"));
+    detail::SetAttribute(group, "block0_items_variety", std::string("regular"));
+
+    // axis0: column names, axis1: index
+    detail::WriteNames(group, "axis0", names);
+    std::vector<int64_t> index(nRows);
+    for (size_t i = 0; i < nRows; ++i) index[i] = i;
+    const hsize_t idims[1] = {nRows};
+    detail::WriteArray(group, "axis1", H5T_NATIVE_INT64, 1, idims, index.data(), "integer");
+
+    // One block holding all the (float) columns, stored row major
+    detail::WriteNames(group, "block0_items", names);
+    std::vector<double> block(nRows * columns.size());
+    for (size_t i = 0; i < nRows; ++i) {
+        for (size_t c = 0; c < columns.size(); ++c) block[i * columns.size() + c] = columns[c][i];
+    }
+    const hsize_t bdims[2] = {nRows, columns.size()};
+    detail::WriteArray(group, "block0_values", H5T_NATIVE_DOUBLE, 2, bdims, block.data(), "");
+
+    H5Gclose(group);
+    H5Fclose(file);
+    return true;
+}
+
+} // namespace PandasH5
@@ -0,0 +1,46 @@
+// Running mean and variance (Welford), which can be merged across workers
+// (Chan et al.) without keeping the individual values.
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+struct RunningStats {
+    uint64_t n = 0;
+    double mean = 0.;
+    double m2 = 0.; // Sum of squared deviations from the mean
+
+    void Add(double x) {
+        ++n;
+        const double delta = x - mean;
+        mean += delta / n;
+        m2 += delta * (x - mean);
+    }
+
+    void Merge(const RunningStats& other) {
+        if (other.n == 0) return;
+        if (n == 0) {
+            *this = other;
+            return;
+        }
+        const uint64_t total = n + other.n;
+        const double delta = other.mean - mean;
+        mean += delta * other.n / total;
+        m2 += other.m2 + delta * delta * n * other.n / total;
+        n = total;
+    }
+
+    // Sample variance
+    double Variance() const { return n > 1 ? m2 / (n - 1) : 0.; }
+    double StdDev() const { return std::sqrt(Variance()); }
+
+    // Standard error of the mean
+    double StdErr() const { return n > 0 ? std::sqrt(Variance() / n) : 0.; }
+
+    // Relative standard error of the mean (infinite while it is unknown)
+    double RelErr() const {
+        if (n < 2) return INFINITY;
+        if (mean == 0.) return m2 == 0. ? 0. : INFINITY;
+        return StdErr() / std::abs(mean);
+    }
+};
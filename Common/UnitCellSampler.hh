@@ -0,0 +1,259 @@
+// Stratified, adaptive sampling of the start positions of the primary
+// electrons over the hexagonal unit cell.
+//
+// The unit-cell yield maps (StudyMapGeneration, TrackRes) are binned on the
+// 49 x 49 (q, r) grid of pd.cut. Instead of sampling a disk and leaving the
+// bins to chance, every bin that overlaps the hexagon gets its own avalanches,
+// started in the part of the bin inside the hexagon. The running mean and
+// variance of the yield of each bin are kept, and a bin stops once the
+// relative error of its mean reaches the target precision. Each round gives
+// the remaining budget to the bins that have not converged, the least precise
+// first, with about the number of avalanches they still need.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ComponentHexCell.hh"
+#include "PandasH5.hh"
+#include "RunningStats.hh"
+
+class UnitCellSampler {
+  public:
+    // Bin edges in q and r, as in StudyMapGeneration and CalcTrackRes.py
+    static constexpr int numbins = 50;
+    static constexpr int nBins = numbins - 1;
+
+    // One avalanche to simulate: the bin and the number of the avalanche in
+    // that bin (to derive its seed)
+    struct Draw {
+        unsigned int bin;
+        unsigned int index;
+    };
+
+    // Centre-to-corner size [cm] and rotation [deg] of the hexagons
+    UnitCellSampler(double size, double rotation) : m_size(size) {
+        m_cos = std::cos(rotation * M_PI / 180.);
+        m_sin = std::sin(rotation * M_PI / 180.);
+        const double width = 2. / nBins;
+        for (int iq = 0; iq < nBins; ++iq) {
+            for (int ir = 0; ir < nBins; ++ir) {
+                Bin bin;
+                bin.q = -1. + (iq + 0.5) * width;
+                bin.r = -1. + (ir + 0.5) * width;
+                // Keep every bin that overlaps the central hexagon: folded
+                // points reach the edge bins too, even if their centre is
+                // outside (649 of the 49 x 49 bins)
+                if (HexOverlap(bin.q, bin.r, width) > 1.e-6) m_bins.push_back(bin);
+            }
+        }
+    }
+
+    // Relative error of the mean yield to reach, avalanches per bin before the
+    // error is trusted, and the most avalanches a bin gets in one round
+    void SetTarget(double precision, unsigned int minSamples, unsigned int maxBatch) {
+        m_precision = precision;
+        m_minSamples = std::max(2u, minSamples);
+        m_maxBatch = std::max(1u, maxBatch);
+    }
+
+    size_t NumberOfBins() const { return m_bins.size(); }
+
+    // Centre of a bin in axial coordinates
+    void GetBinCentre(unsigned int bin, double& q, double& r) const {
+        q = m_bins[bin].q;
+        r = m_bins[bin].r;
+    }
+
+    bool Converged(unsigned int bin) const {
+        const auto& stats = m_bins[bin].stats;
+        return stats.n >= m_minSamples && stats.RelErr() <= m_precision;
+    }
+
+    // Avalanches of the next round, at most budget of them. Empty once all
+    // the bins converged or the budget is used up.
+    std::vector<Draw> NextRound(uint64_t budget) {
+        struct Request {
+            unsigned int bin;
+            unsigned int n;
+            double relErr;
+        };
+        std::vector<Request> requests;
+        for (unsigned int b = 0; b < m_bins.size(); ++b) {
+            if (Converged(b)) continue;
+            const auto& stats = m_bins[b].stats;
+            const double relErr = stats.RelErr();
+            double needed = m_minSamples;
+            if (stats.n >= m_minSamples) {
+                // The error goes as 1/sqrt(n); double the bin if it is not known yet
+                needed = std::isfinite(relErr) ? stats.n * std::pow(relErr / m_precision, 2) : 2. * stats.n;
+            }
+            const double n = std::min<double>(m_maxBatch, std::ceil(needed - stats.n));
+            requests.push_back({b, std::max(1u, static_cast<unsigned int>(n)), relErr});
+        }
+        std::stable_sort(requests.begin(), requests.end(),
+                         [](const Request& a, const Request& b) { return a.relErr > b.relErr; });
+
+        std::vector<unsigned int> counts(m_bins.size(), 0);
+        for (const auto& req : requests) {
+            const unsigned int n = static_cast<unsigned int>(std::min<uint64_t>(req.n, budget));
+            counts[req.bin] = n;
+            budget -= n;
+            if (budget == 0) break;
+        }
+
+        // In bin order, so the round does not depend on the order of the requests
+        std::vector<Draw> draws;
+        for (unsigned int b = 0; b < m_bins.size(); ++b) {
+            for (unsigned int k = 0; k < counts[b]; ++k) draws.push_back({b, m_bins[b].issued++});
+        }
+        ++m_rounds;
+        return draws;
+    }
+
+    // Uniform start position (x, y) [cm] in the part of a bin inside the
+    // central hexagon. Points outside are rejected; every bin has at least an
+    // eighth of its area inside, so this takes a few attempts at most.
+    template <typename Rng>
+    void Sample(unsigned int bin, Rng& rng, double& x, double& y) const {
+        const double width = 2. / nBins;
+        double q = 0., r = 0.;
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            q = m_bins[bin].q + rng.Uniform(-0.5, 0.5) * width;
+            r = m_bins[bin].r + rng.Uniform(-0.5, 0.5) * width;
+            int nq, nr;
+            ComponentHexCell::HexRound(q, r, nq, nr);
+            if (nq == 0 && nr == 0) break;
+        }
+        double xl, yl;
+        ToCartesian(q, r, xl, yl);
+        x = m_cos * xl - m_sin * yl;
+        y = m_sin * xl + m_cos * yl;
+    }
+
+    // Excitation yield of an avalanche of a bin
+    void Add(unsigned int bin, double yield) {
+        m_bins[bin].stats.Add(yield);
+        m_avalanches.push_back({bin, yield});
+    }
+
+    void PrintSummary() const {
+        unsigned int nConverged = 0;
+        double worst = 0.;
+        for (unsigned int b = 0; b < m_bins.size(); ++b) {
+            if (Converged(b)) ++nConverged;
+            worst = std::max(worst, m_bins[b].stats.RelErr());
+        }
+        std::cout << "UnitCellSampler: " << m_avalanches.size() << " avalanches in " << m_rounds
+                  << " rounds, " << nConverged << " of " << m_bins.size()
+                  << " bins reached a relative error of " << m_precision
+                  << " (largest error " << worst << ")" << std::endl;
+    }
+
+    // Write the maps in the layout of StudyMapGeneration (x, y in mm), with
+    //   unitfile: one row per bin with the mean yield and its convergence
+    //   distfile: one row per avalanche, for the dist sampling of TrackRes
+    bool Write(const std::string& unitfile, const std::string& distfile) const {
+        std::vector<double> q, r, mean, x, y, n, stddev, relErr, converged;
+        for (unsigned int b = 0; b < m_bins.size(); ++b) {
+            const auto& bin = m_bins[b];
+            if (bin.stats.n == 0) continue;
+            double xb, yb;
+            ToCartesian(bin.q, bin.r, xb, yb);
+            q.push_back(bin.q);
+            r.push_back(bin.r);
+            mean.push_back(bin.stats.mean);
+            x.push_back(10. * xb);
+            y.push_back(10. * yb);
+            n.push_back(bin.stats.n);
+            stddev.push_back(bin.stats.StdDev());
+            relErr.push_back(bin.stats.RelErr());
+            converged.push_back(Converged(b) ? 1. : 0.);
+        }
+        if (!PandasH5::WriteFrame(unitfile, "Yields",
+                                  {"q", "r", "excitation", "x", "y", "n", "std", "rel_error", "converged"},
+                                  {q, r, mean, x, y, n, stddev, relErr, converged})) {
+            return false;
+        }
+
+        std::vector<double> aq, ar, yield, ax, ay;
+        for (const auto& aval : m_avalanches) {
+            const auto& bin = m_bins[aval.bin];
+            double xb, yb;
+            ToCartesian(bin.q, bin.r, xb, yb);
+            aq.push_back(bin.q);
+            ar.push_back(bin.r);
+            yield.push_back(aval.yield);
+            ax.push_back(10. * xb);
+            ay.push_back(10. * yb);
+        }
+        return PandasH5::WriteFrame(distfile, "Yields", {"q", "r", "excitation", "x", "y"},
+                                    {aq, ar, yield, ax, ay});
+    }
+
+  private:
+    struct Bin {
+        double q = 0., r = 0.; // Centre
+        RunningStats stats;
+        unsigned int issued = 0; // Avalanches handed out so far
+    };
+
+    struct Avalanche {
+        unsigned int bin;
+        double yield;
+    };
+
+    double m_size;
+    double m_cos = 1., m_sin = 0.;
+    double m_precision = 0.01;
+    unsigned int m_minSamples = 16;
+    unsigned int m_maxBatch = 64;
+    unsigned int m_rounds = 0;
+
+    std::vector<Bin> m_bins;
+    std::vector<Avalanche> m_avalanches;
+
+    // Fraction of the bin of width w around (q, r) that lies in the central
+    // hexagon |q - r|, |2q + r|, |q + 2r| <= 1 (the points HexRound takes to
+    // (0, 0)): the square is clipped by the six edges and its area taken
+    static double HexOverlap(double q, double r, double w) {
+        std::vector<std::pair<double, double>> poly = {
+            {q - 0.5 * w, r - 0.5 * w}, {q + 0.5 * w, r - 0.5 * w},
+            {q + 0.5 * w, r + 0.5 * w}, {q - 0.5 * w, r + 0.5 * w}};
+        const double edges[6][2] = {{1., -1.}, {-1., 1.}, {2., 1.}, {-2., -1.}, {1., 2.}, {-1., -2.}};
+        for (const auto& e : edges) {
+            std::vector<std::pair<double, double>> clipped;
+            for (size_t i = 0; i < poly.size(); ++i) {
+                const auto& a = poly[i];
+                const auto& b = poly[(i + 1) % poly.size()];
+                const double da = e[0] * a.first + e[1] * a.second - 1.;
+                const double db = e[0] * b.first + e[1] * b.second - 1.;
+                if (da <= 0.) clipped.push_back(a);
+                if (da * db < 0.) {
+                    const double t = da / (da - db);
+                    clipped.push_back({a.first + t * (b.first - a.first), a.second + t * (b.second - a.second)});
+                }
+            }
+            poly.swap(clipped);
+            if (poly.empty()) return 0.;
+        }
+        double area = 0.;
+        for (size_t i = 0; i < poly.size(); ++i) {
+            const auto& a = poly[i];
+            const auto& b = poly[(i + 1) % poly.size()];
+            area += a.first * b.second - b.first * a.second;
+        }
+        return 0.5 * std::abs(area) / (w * w);
+    }
+
+    // Position in the frame of the lattice
+    void ToCartesian(double q, double r, double& x, double& y) const {
+        x = m_size * std::sqrt(3.) * (q + 0.5 * r);
+        y = m_size * 1.5 * r;
+    }
+};
@@ -0,0 +1,311 @@
+// Pool of worker processes for running independent work items (avalanches,
+// sweep points, ...) on several cores of one node.
+//
+// Garfield keeps its random engine and the Magboltz collision counters in
+// process-wide state, so the workers are forked processes rather than threads.
+// Everything set up before Run() is called (gas tables, field maps) is shared
+// copy-on-write with the workers, and each worker ends up with its own copy of
+// the Sensor, AvalancheMicroscopic and MediumMagboltz objects. Work items are
+// handed out one at a time from a counter in shared memory, so fast workers
+// simply take more items. Each worker serialises its result into a byte string
+// which is piped back to the parent, where the results are passed on to the
+// sink in item order. No item is handed out more than a fixed window ahead of
+// the first unfinished one, so a slow item does not let the finished results
+// behind it pile up in the parent.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace WorkerPool {
+
+// Fill the payload with the result of work item "item".
+using Task = std::function<void(unsigned int item, std::string& payload)>;
+
+// Consume the payload of work item "item". Called in the parent, in item order.
+using Sink = std::function<void(unsigned int item, const std::string& payload)>;
+
+// Derive the random seed of a work item from the job seed (splitmix64). The
+// seed only depends on the item number, so the results do not depend on the
+// number of workers or on which worker ran the item.
+inline unsigned int ItemSeed(unsigned int seed, unsigned int item) {
+    uint64_t z = (static_cast<uint64_t>(seed) << 32) + item + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    // ROOT treats a seed of 0 as "pick a random seed"
+    const unsigned int s = static_cast<unsigned int>(z);
+    return s == 0 ? 1 : s;
+}
+
+// Append the raw bytes of a trivially copyable value to a payload
+template <typename T>
+void Pack(std::string& payload, const T& value) {
+    payload.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void Pack(std::string& payload, const std::vector<T>& values) {
+    Pack(payload, static_cast<uint64_t>(values.size()));
+    payload.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+// Read back a value written with Pack, starting at offset pos
+template <typename T>
+void Unpack(const std::string& payload, size_t& pos, T& value) {
+    std::memcpy(&value, payload.data() + pos, sizeof(T));
+    pos += sizeof(T);
+}
+
+template <typename T>
+void Unpack(const std::string& payload, size_t& pos, std::vector<T>& values) {
+    uint64_t n = 0;
+    Unpack(payload, pos, n);
+    values.resize(n);
+    std::memcpy(values.data(), payload.data() + pos, n * sizeof(T));
+    pos += n * sizeof(T);
+}
+
+namespace detail {
+
+inline bool WriteAll(int fd, const char* buf, size_t n) {
+    while (n > 0) {
+        const ssize_t w = write(fd, buf, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += w;
+        n -= w;
+    }
+    return true;
+}
+
+// Message header: item number and payload size
+constexpr size_t kHeaderSize = sizeof(uint32_t) + sizeof(uint64_t);
+
+// Counters shared between the parent and the workers
+struct Shared {
+    std::atomic<unsigned int> next{0};     // Next item to hand out
+    std::atomic<unsigned int> done{0};     // Items passed on to the sink
+    std::atomic<bool> abort{false};        // A worker failed, stop waiting
+};
+
+// Take the next item, but none more than window items ahead of the ones the
+// parent has passed on, so that the results waiting to be put in order (and
+// the memory they take) stay bounded however slow one item is
+inline bool NextItem(Shared* shared, unsigned int nItems, unsigned int window, unsigned int& item) {
+    unsigned int cur = shared->next.load();
+    while (true) {
+        if (cur >= nItems || shared->abort.load()) return false;
+        if (cur >= shared->done.load() + window) {
+            usleep(500);
+            cur = shared->next.load();
+            continue;
+        }
+        if (shared->next.compare_exchange_weak(cur, cur + 1)) {
+            item = cur;
+            return true;
+        }
+    }
+}
+
+inline void RunWorker(int fd, Shared* shared, unsigned int nItems, unsigned int window, const Task& task) {
+    bool ok = true;
+    std::string payload;
+    unsigned int item = 0;
+    while (ok && NextItem(shared, nItems, window, item)) {
+        payload.clear();
+        task(item, payload);
+
+        std::string header;
+        Pack(header, static_cast<uint32_t>(item));
+        Pack(header, static_cast<uint64_t>(payload.size()));
+        ok = WriteAll(fd, header.data(), header.size()) && WriteAll(fd, payload.data(), payload.size());
+    }
+    close(fd);
+
+    // Leave without running the parent's destructors and atexit handlers
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+// Message being read from a worker: the header, then the payload, read
+// straight into the string that is handed to the sink
+struct Incoming {
+    char header[kHeaderSize];
+    size_t nHeader = 0;
+    uint32_t item = 0;
+    std::string payload;
+    size_t nPayload = 0;
+};
+
+} // namespace detail
+
+// Run work items 0 ... nItems-1 on nWorkers processes. With a single worker
+// everything runs in the calling process. Returns false if a worker failed.
+// At most window items (default: four per worker) are run ahead of the first
+// one that has not finished, which bounds the results held in the parent.
+inline bool Run(unsigned int nItems, unsigned int nWorkers, const Task& task, const Sink& sink,
+                unsigned int window = 0) {
+
+    if (nWorkers > nItems) nWorkers = nItems;
+
+    if (nWorkers <= 1) {
+        std::string payload;
+        for (unsigned int i = 0; i < nItems; ++i) {
+            payload.clear();
+            task(i, payload);
+            sink(i, payload);
+        }
+        return true;
+    }
+
+    if (window == 0) window = 4 * nWorkers;
+    window = std::max(window, nWorkers);
+
+    void* shm = mmap(nullptr, sizeof(detail::Shared), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        std::cerr << "WorkerPool::Run: Could not allocate shared memory." << std::endl;
+        return false;
+    }
+    auto* shared = new (shm) detail::Shared();
+
+    // Don't let the children inherit (and print again) buffered output
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    std::vector<int> fds;
+    std::vector<pid_t> pids;
+    for (unsigned int w = 0; w < nWorkers; ++w) {
+        int p[2];
+        if (pipe(p) != 0) {
+            std::cerr << "WorkerPool::Run: Could not create pipe." << std::endl;
+            break;
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "WorkerPool::Run: Could not fork worker " << w << "." << std::endl;
+            close(p[0]);
+            close(p[1]);
+            break;
+        }
+        if (pid == 0) {
+            close(p[0]);
+            for (const int fd : fds) close(fd);
+            detail::RunWorker(p[1], shared, nItems, window, task);
+        }
+        close(p[1]);
+        fds.push_back(p[0]);
+        pids.push_back(pid);
+    }
+
+    // Collect the results and hand them to the sink in item order
+    std::vector<detail::Incoming> incoming(fds.size());
+    std::vector<bool> open(fds.size(), true);
+    std::vector<bool> reaped(fds.size(), false);
+    std::map<unsigned int, std::string> pending;
+    unsigned int nextOut = 0;
+    size_t nOpen = fds.size();
+    bool ok = true;
+
+    while (nOpen > 0) {
+        std::vector<pollfd> pfds;
+        std::vector<size_t> index;
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (!open[k]) continue;
+            pfds.push_back({fds[k], POLLIN, 0});
+            index.push_back(k);
+        }
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (size_t j = 0; j < pfds.size(); ++j) {
+            if (!(pfds[j].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            const size_t k = index[j];
+            detail::Incoming& in = incoming[k];
+            ssize_t n = 0;
+            if (in.nHeader < detail::kHeaderSize) {
+                n = read(fds[k], in.header + in.nHeader, detail::kHeaderSize - in.nHeader);
+            } else {
+                n = read(fds[k], &in.payload[in.nPayload], in.payload.size() - in.nPayload);
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fds[k]);
+                open[k] = false;
+                --nOpen;
+                // A worker that died would leave the others waiting for its item
+                int status = 0;
+                waitpid(pids[k], &status, 0);
+                reaped[k] = true;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    ok = false;
+                    shared->abort = true;
+                }
+                continue;
+            }
+
+            if (in.nHeader < detail::kHeaderSize) {
+                in.nHeader += n;
+                if (in.nHeader < detail::kHeaderSize) continue;
+                uint64_t size = 0;
+                std::memcpy(&in.item, in.header, sizeof(uint32_t));
+                std::memcpy(&size, in.header + sizeof(uint32_t), sizeof(uint64_t));
+                in.payload.resize(size);
+                in.nPayload = 0;
+            } else {
+                in.nPayload += n;
+            }
+            if (in.nPayload == in.payload.size()) {
+                pending.emplace(in.item, std::move(in.payload));
+                in.payload = std::string();
+                in.nHeader = 0;
+            }
+        }
+
+        while (!pending.empty() && pending.begin()->first == nextOut) {
+            sink(nextOut, pending.begin()->second);
+            pending.erase(pending.begin());
+            ++nextOut;
+        }
+        shared->done = nextOut;
+    }
+
+    for (size_t k = 0; k < pids.size(); ++k) {
+        if (reaped[k]) continue;
+        int status = 0;
+        waitpid(pids[k], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    munmap(shm, sizeof(detail::Shared));
+
+    if (nextOut != nItems) {
+        std::cerr << "WorkerPool::Run: Only " << nextOut << " of " << nItems
+                  << " work items completed." << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace WorkerPool
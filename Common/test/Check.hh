@@ -0,0 +1,27 @@
+// Minimal checks for the tests of the Common headers: CHECK reports a failed
+// condition and the test returns Check::Result() from main.
+#pragma once
+
+#include <iostream>
+
+namespace Check {
+
+inline int& Failures() {
+    static int n = 0;
+    return n;
+}
+
+inline int Result() {
+    if (Failures() > 0) std::cerr << Failures() << " check(s) failed" << std::endl;
+    return Failures() > 0 ? 1 : 0;
+}
+
+} // namespace Check
+
+#define CHECK(cond, what)                                                            \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << what << std::endl;   \
+            ++Check::Failures();                                                     \
+        }                                                                            \
+    } while (0)
@@ -0,0 +1,33 @@
+// Stand-in for the interface of Garfield::Component that the Common headers
+// use, so that they can be tested without Garfield.
+#pragma once
+
+#include <string>
+
+#include "Garfield/Medium.hh"
+
+namespace Garfield {
+
+class Component {
+  public:
+    Component() = default;
+    explicit Component(const std::string& name) : m_className(name) {}
+    virtual ~Component() = default;
+
+    virtual void ElectricField(const double x, const double y, const double z, double& ex,
+                               double& ey, double& ez, Medium*& m, int& status) = 0;
+    virtual void ElectricField(const double x, const double y, const double z, double& ex,
+                               double& ey, double& ez, double& v, Medium*& m, int& status) = 0;
+    virtual Medium* GetMedium(const double x, const double y, const double z) = 0;
+    virtual bool GetVoltageRange(double& vmin, double& vmax) = 0;
+    virtual bool GetBoundingBox(double& /*xmin*/, double& /*ymin*/, double& /*zmin*/,
+                                double& /*xmax*/, double& /*ymax*/, double& /*zmax*/) {
+        return false;
+    }
+
+  protected:
+    std::string m_className = "Component";
+    bool m_ready = false;
+};
+
+} // namespace Garfield
@@ -0,0 +1,18 @@
+// Stand-in for the part of Garfield::Medium that the Common headers use, so
+// that they can be tested without Garfield.
+#pragma once
+
+namespace Garfield {
+
+class Medium {
+  public:
+    virtual ~Medium() = default;
+
+    void SetDriftable(bool on) { m_driftable = on; }
+    bool IsDriftable() const { return m_driftable; }
+
+  private:
+    bool m_driftable = true;
+};
+
+} // namespace Garfield
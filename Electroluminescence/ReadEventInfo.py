@@ -0,0 +1,80 @@
+import glob
+import h5py
+import numpy  as np
+import pandas as pd
+
+# Load the EventInfo.h5 files written by Mesh and CRAB into the same
+# dataframes the notebooks used to get from the csv files, e.g.
+#
+# from ReadEventInfo import load_eventinfo, load_metadata
+# data = load_eventinfo("../Files/Aligned/EventInfo_*.h5")
+# meta = load_metadata("../Files/Aligned/EventInfo_*.h5")
+#
+# The Summary.h5 files of output=summary have the same Metadata, and the
+# binned profiles and moments of the excitations instead of the EventInfo:
+#
+# profiles, moments = load_summary("../Files/Aligned/Summary_*.h5")
+
+def _read_group(filename, group):
+    df = pd.DataFrame()
+    with h5py.File(filename, "r") as f:
+        for name, dset in f[group].items():
+            values = dset[:]
+            # Quantised columns are stored as integers with a scale factor
+            if "scale" in dset.attrs:
+                values = values * dset.attrs["scale"]
+            df[name] = values
+    return df
+
+def _read_files(filewildcard, group, columns):
+    files = sorted(glob.glob(filewildcard))
+    df = pd.concat([_read_group(f, group) for f in files], ignore_index=True)
+    return df[columns]
+
+# event, x, y, z, t of every excitation
+def load_eventinfo(filewildcard):
+    return _read_files(filewildcard, "EventInfo", ["event", "x", "y", "z", "t"])
+
+# One row per avalanche, with the column names used in the notebooks
+def load_metadata(filewildcard):
+    df = _read_files(filewildcard, "Metadata", ["event", "electrons", "ions", "elastic", "ionisations",
+                                                "attachment", "inelastic", "excitation", "top", "bottom",
+                                                "start_x", "start_y", "start_z", "start_E", "end_E"])
+    return df.rename(columns = {"start_x": "start x", "start_y": "start y", "start_z": "start z",
+                                "start_E": "start E", "end_E": "end E"})
+
+# Profiles (t, z, r) and moments summed over the Summary.h5 files. Returns a
+# dict of dataframes with the bin edges and counts of each profile, whose
+# attrs hold the underflow and overflow, and a dataframe of n, mean and std
+# of each quantity (merged as in RunningStats.hh).
+def load_summary(filewildcard):
+    profiles = {}
+    moments  = {}
+    for filename in sorted(glob.glob(filewildcard)):
+        with h5py.File(filename, "r") as f:
+            for name, group in f["Profiles"].items():
+                counts = group["counts"]
+                if name not in profiles:
+                    edges = group["edges"][:]
+                    profiles[name] = pd.DataFrame({"low": edges[:-1], "high": edges[1:],
+                                                   "counts": np.zeros(len(counts), dtype=np.int64)})
+                    profiles[name].attrs = {"underflow": 0, "overflow": 0}
+                profiles[name]["counts"] += counts[:].astype(np.int64)
+                for flow in ["underflow", "overflow"]:
+                    profiles[name].attrs[flow] += int(counts.attrs[flow])
+
+            for name, dset in f["Moments"].items():
+                n, mean, std = dset[:]
+                m2 = std**2 * (n - 1) if n > 1 else 0.
+                if name not in moments or moments[name][0] == 0:
+                    moments[name] = [n, mean, m2]
+                elif n > 0:
+                    n1, mean1, m21 = moments[name]
+                    total = n1 + n
+                    delta = mean - mean1
+                    moments[name] = [total, mean1 + delta * n / total, m21 + m2 + delta**2 * n1 * n / total]
+
+    df = pd.DataFrame([[name, n, mean, np.sqrt(m2 / (n - 1)) if n > 1 else 0.]
+                       for name, (n, mean, m2) in moments.items()],
+                      columns = ["quantity", "n", "mean", "std"])
+    return profiles, df.set_index("quantity")
@@ -1,6 +1,7 @@
 #!/bin/bash
 #SBATCH -J CRAB # A single job name for the array
 #SBATCH --nodes=1
+#SBATCH --cpus-per-task=1 # Raise together with N_THREADS
 #SBATCH --mem 4000 # Memory request (6Gb)
 #SBATCH -t 0-12:00 # Maximum execution time (D-HH:MM)
 #SBATCH -o CRAB_%A_%a.out # Standard output
@@ -12,6 +13,7 @@ start=`date +%s`
 JOBNAME="Mesh"
 TYPE="CRAB"
 N_EVENTS=20
+N_THREADS=1 # Worker processes sharing one field map
 
 # Create the directory
 cd /media/argon/NVME1/Krishan/
@@ -29,7 +31,7 @@ echo "The seed number is: ${SEED}" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_I
 # NEXUS
 echo "Running Garfield" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 # evt id, num e-, seed, grid, jobid, mode [align, rot, shift]
-/home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/build/CRAB ${SEED} ${N_EVENTS} ${SEED} 1 ${SLURM_ARRAY_TASK_ID} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+/home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/build/CRAB ${SEED} ${N_EVENTS} ${SEED} 1 ${SLURM_ARRAY_TASK_ID} threads=${N_THREADS} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 
 echo; echo; echo;
 
@@ -1,6 +1,7 @@
 #!/bin/bash
 #SBATCH -J Trackres # A single job name for the array
 #SBATCH --nodes=1
+#SBATCH --cpus-per-task=4 # Threads of TrackRes
 #SBATCH --mem 4000 # Memory request (6Gb)
 #SBATCH -t 0-24:00 # Maximum execution time (D-HH:MM)
 #SBATCH -o Trackres_%A_%a.out # Standard output
@@ -17,6 +18,7 @@ FILES_PER_JOB=1
 N_EVENTS=1000
 CONFIG=NEXT100.eminus.config.mac
 INIT=NEXT100.eminus.init.mac
+N_THREADS=${SLURM_CPUS_PER_TASK:-1}
 
 # Create the directory
 cd /media/argon/HDD_8tb/Krishan/
@@ -26,7 +28,6 @@ cd $JOBNAME/$Mode/jobid_"${SLURM_ARRAY_TASK_ID}"
 # Copy the files over
 cp /home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/config/${CONFIG} .
 cp /home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/config/${INIT} .
-cp /home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/CalcTrackRes.py .
 cp /home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/Maps/*.h5 .
 
 # Setup nexus and run
@@ -47,7 +48,7 @@ for i in $(eval echo "{1..${FILES_PER_JOB}}"); do
     nexus -n $N_EVENTS ${INIT} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 
     # Now run the Track resolution script
-    python -u CalcTrackRes.py $Mode $Option | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+    /home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/build/TrackRes $Mode $Option threads=${N_THREADS} seed=${SEED} | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 
     echo; echo; echo;
 done
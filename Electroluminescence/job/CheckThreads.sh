@@ -0,0 +1,35 @@
+#!/bin/bash
+# Check that Mesh or CRAB write the same avalanches whatever the number of
+# worker processes: run the same events with threads=1 and threads=4 and
+# compare the two EventInfo files with h5diff (part of HDF5).
+#
+# Run from the directory the program reads its files from, e.g.
+#   bash job/CheckThreads.sh build/Mesh 1 20 1 0 Aligned Aligned_Mesh_Data_Rings.mphtxt Aligned_Mesh_Data_Rings.txt 13.5
+#   bash job/CheckThreads.sh build/CRAB 1 20 1 0
+# i.e. the program and its positional arguments without the job id, which is
+# set to threads1 and threads4 here.
+
+if [ $# -lt 5 ]; then
+    echo "Usage: $0 <program> <first event> <num e-> <seed> <grid> [other positional arguments]"
+    exit 1
+fi
+
+PROGRAM=$1
+FIRST=$2
+N_EVENTS=$3
+SEED=$4
+GRID=$5
+shift 5
+
+for N_THREADS in 1 4; do
+    echo "Running ${PROGRAM} with ${N_THREADS} worker(s)"
+    ${PROGRAM} ${FIRST} ${N_EVENTS} ${SEED} ${GRID} threads${N_THREADS} "$@" \
+        threads=${N_THREADS} verbose=0 plot=0 > log_threads${N_THREADS}.txt 2>&1 || exit 1
+done
+
+if h5diff EventInfo_threads1.h5 EventInfo_threads4.h5; then
+    echo "OK: threads=1 and threads=4 give the same output"
+else
+    echo "FAILED: EventInfo_threads1.h5 and EventInfo_threads4.h5 differ"
+    exit 1
+fi
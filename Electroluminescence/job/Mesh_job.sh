@@ -1,6 +1,7 @@
 #!/bin/bash
 #SBATCH -J Mesh # A single job name for the array
 #SBATCH --nodes=1
+#SBATCH --cpus-per-task=1 # Raise together with N_THREADS
 #SBATCH --mem 4000 # Memory request (6Gb)
 #SBATCH -t 0-24:00 # Maximum execution time (D-HH:MM)
 #SBATCH -o Mesh_%A_%a.out # Standard output
@@ -12,6 +13,7 @@ start=`date +%s`
 JOBNAME="Mesh"
 TYPE="Aligned"
 N_EVENTS=20
+N_THREADS=1 # Worker processes sharing one field map
 PRESSURE=13.5
 MPHFILE="Aligned_Mesh_Data_Rings.mphtxt"
 DATAFILE="Aligned_Mesh_Data_Rings.txt"
@@ -32,7 +34,7 @@ echo "The seed number is: ${SEED}" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_I
 # NEXUS
 echo "Running Garfield" 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 # evt id, num e-, seed, grid, jobid, mode [Aligned, Rotated, Shifted] gridfile datafile pressure
-/home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/build/Mesh ${SEED} ${N_EVENTS} ${SEED} 1 ${SLURM_ARRAY_TASK_ID} ${TYPE} ${MPHFILE} ${DATAFILE} ${PRESSURE} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
+/home/argon/Projects/Krishan/GarfieldCode/Electroluminescence/build/Mesh ${SEED} ${N_EVENTS} ${SEED} 1 ${SLURM_ARRAY_TASK_ID} ${TYPE} ${MPHFILE} ${DATAFILE} ${PRESSURE} threads=${N_THREADS} 2>&1 | tee -a log_nexus_"${SLURM_ARRAY_TASK_ID}".txt
 
 echo; echo; echo;
 